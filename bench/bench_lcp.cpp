@@ -0,0 +1,225 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bench_lcp.cpp
+ *
+ *  Created on: Jan 14, 2019
+ *      Author: nico
+ *
+ *  End-to-end benchmark of bwt2lcp and merge_bwt on synthetic read collections. For both alphabets and all
+ *  LCP widths, times each phase (load, leaves, nodes, save) and prints a tab-separated table.
+ */
+
+#include <iostream>
+#include <unistd.h>
+#include <chrono>
+#include "internal/lcp.hpp"
+#include "internal/bwt_merger.hpp"
+#include "bench/read_generator.hpp"
+
+using namespace std;
+
+read_collection_params params;
+
+string tmp_dir = "/tmp";
+string output_file;
+
+ostream * table = &cout;
+streambuf * cout_buf = NULL;
+ofstream null_stream;
+
+void help(){
+
+	cout << "bench_lcp [options]" << endl <<
+	"Generates two read collections from the same random genome, computes their eBWTs, and times" << endl <<
+	"bwt2lcp and merge_bwt per phase for both alphabets and all LCP widths. Output: tab-separated table." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-g <arg>    Genome length. Default: " << params.genome_length << "." << endl <<
+	"-c <arg>    Coverage of each collection. Default: " << params.coverage << "." << endl <<
+	"-r <arg>    Read length. Default: " << params.read_length << "." << endl <<
+	"-e <arg>    Substitution error rate. Default: " << params.error_rate << "." << endl <<
+	"-n <arg>    Rate of 'N' bases in the runs on alphabet {A,C,G,N,T,#}. Default: 0.001." << endl <<
+	"-s <arg>    Random seed. Default: " << params.seed << "." << endl <<
+	"-w <arg>    Directory for temporary files. Default: " << tmp_dir << "." << endl <<
+	"-o <arg>    Output table. Default: standard output." << endl;
+	exit(0);
+}
+
+double seconds_since(chrono::steady_clock::time_point t){
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+void row(string tool, string alphabet, int width, uint64_t n, string phase, double seconds){
+
+	*table << tool << "\t" << alphabet << "\t" << width << "\t" << n << "\t" << phase << "\t" << seconds << "\t" <<
+			(seconds > 0 ? (n/seconds)/1000000 : 0) << endl;
+
+}
+
+void rows(string tool, string alphabet, int width, uint64_t n, run_stats & stats){
+
+	for(auto & p : stats.phases) row(tool, alphabet, width, n, p.name, p.wall);
+
+}
+
+//silence the library output while running
+void quiet(){ cout.rdbuf(null_stream.rdbuf()); }
+void verbose(){ cout.rdbuf(cout_buf); }
+
+template<class bwt_t, typename lcp_int_t>
+void bench_bwt2lcp(string bwt_path, string alphabet){
+
+	auto t = chrono::steady_clock::now();
+	bwt_t BWT(bwt_path);
+	double load = seconds_since(t);
+
+	lcp<bwt_t, lcp_int_t> M(&BWT);
+	M.save_to_file(tmp_dir + "/bench.lcp");
+
+	verbose();
+	row("bwt2lcp", alphabet, sizeof(lcp_int_t), BWT.size(), "load", load);
+	rows("bwt2lcp", alphabet, sizeof(lcp_int_t), BWT.size(), M.stats);
+	quiet();
+
+}
+
+template<class bwt_t, typename lcp_int_t>
+void bench_merge_bwt(string bwt1_path, string bwt2_path, string alphabet, bool compute_lcp){
+
+	auto t = chrono::steady_clock::now();
+	bwt_t BWT1(bwt1_path);
+	bwt_t BWT2(bwt2_path);
+	double load = seconds_since(t);
+
+	merge_options opt;
+
+	opt.compute_lcp = compute_lcp;
+	opt.out_da = true;
+
+	bwt_merger<bwt_t, lcp_int_t> M(&BWT1, &BWT2, opt);
+	M.save_to_file(tmp_dir + "/bench.merge");
+
+	uint64_t n = BWT1.size() + BWT2.size();
+	int width = compute_lcp ? sizeof(lcp_int_t) : 0;
+
+	verbose();
+	row("merge_bwt", alphabet, width, n, "load", load);
+	rows("merge_bwt", alphabet, width, n, M.stats);
+	quiet();
+
+}
+
+template<class bwt_t>
+void bench_alphabet(string bwt1_path, string bwt2_path, string alphabet){
+
+	bench_bwt2lcp<bwt_t, uint8_t>(bwt1_path, alphabet);
+	bench_bwt2lcp<bwt_t, uint16_t>(bwt1_path, alphabet);
+	bench_bwt2lcp<bwt_t, uint32_t>(bwt1_path, alphabet);
+	bench_bwt2lcp<bwt_t, uint64_t>(bwt1_path, alphabet);
+
+	bench_merge_bwt<bwt_t, uint8_t>(bwt1_path, bwt2_path, alphabet, false);
+	bench_merge_bwt<bwt_t, uint8_t>(bwt1_path, bwt2_path, alphabet, true);
+	bench_merge_bwt<bwt_t, uint16_t>(bwt1_path, bwt2_path, alphabet, true);
+	bench_merge_bwt<bwt_t, uint32_t>(bwt1_path, bwt2_path, alphabet, true);
+	bench_merge_bwt<bwt_t, uint64_t>(bwt1_path, bwt2_path, alphabet, true);
+
+}
+
+/*
+ * generate two collections with the given N rate and store their eBWTs in tmp_dir. Return the paths.
+ */
+pair<string, string> generate(double n_rate){
+
+	read_collection_params p = params;
+	p.n_rate = n_rate;
+
+	string path1 = tmp_dir + "/bench1.bwt";
+	string path2 = tmp_dir + "/bench2.bwt";
+
+	auto reads = generate_reads(p, params.seed);
+	auto bwt = ebwt(reads);
+	save_string(path1, bwt);
+
+	p.seed++;
+	reads = generate_reads(p, params.seed);
+	bwt = ebwt(reads);
+	save_string(path2, bwt);
+
+	return {path1, path2};
+
+}
+
+int main(int argc, char** argv){
+
+	double n_rate = 0.001;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "hg:c:r:e:n:s:w:o:")) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'g':
+				params.genome_length = atoll(optarg);
+			break;
+			case 'c':
+				params.coverage = atof(optarg);
+			break;
+			case 'r':
+				params.read_length = atoll(optarg);
+			break;
+			case 'e':
+				params.error_rate = atof(optarg);
+			break;
+			case 'n':
+				n_rate = atof(optarg);
+			break;
+			case 's':
+				params.seed = atoll(optarg);
+			break;
+			case 'w':
+				tmp_dir = string(optarg);
+			break;
+			case 'o':
+				output_file = string(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	ofstream out;
+
+	if(output_file.size()>0){
+
+		out.open(output_file);
+		table = &out;
+
+	}
+
+	cout_buf = cout.rdbuf();
+
+	*table << "tool\talphabet\tlcp_bytes\tn\tphase\tseconds\tMchars_per_s" << endl;
+
+	cerr << "Generating collections on alphabet {A,C,G,T,#} ... " << endl;
+	auto paths = generate(0);
+
+	quiet();
+	bench_alphabet<dna_bwt_t>(paths.first, paths.second, "ACGT");
+	verbose();
+
+	cerr << "Generating collections on alphabet {A,C,G,N,T,#} ... " << endl;
+	paths = generate(n_rate);
+
+	quiet();
+	bench_alphabet<dna_bwt_n_t>(paths.first, paths.second, "ACGNT");
+	verbose();
+
+	for(string f : {"/bench1.bwt", "/bench2.bwt", "/bench.lcp", "/bench.merge.bwt", "/bench.merge.da", "/bench.merge.lcp"})
+		remove((tmp_dir + f).c_str());
+
+}
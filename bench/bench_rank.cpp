@@ -0,0 +1,205 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bench_rank.cpp
+ *
+ *  Created on: Jan 15, 2019
+ *      Author: nico
+ *
+ *  Microbenchmarks of the hot kernels: parallel rank on the two packed string layouts (dna_string, 128 characters
+ *  per block; dna_string_n, 117 characters per block) and left extensions dna_bwt::LF(range_t), dna_bwt::LF(sa_node).
+ *  Each kernel is run on random and sequential positions, on a small (cache-resident) and a large (DRAM-resident)
+ *  string. Prints a tab-separated table with ns/op and ops/s.
+ */
+
+#include <iostream>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include "internal/dna_bwt.hpp"
+#include "internal/dna_bwt_n.hpp"
+
+using namespace std;
+
+uint64_t small_size = 1<<15;//32 KiB characters = 16 KiB packed: fits in L1/L2
+uint64_t large_size = 1<<28;//256 Mi characters = 128 MiB packed
+uint64_t n_ops = 10000000;
+uint64_t seed = 1;
+
+void help(){
+
+	cout << "bench_rank [options]" << endl <<
+	"Microbenchmarks of parallel rank and LF kernels. Output: tab-separated table." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-s <arg>    Length of the cache-resident string. Default: " << small_size << "." << endl <<
+	"-l <arg>    Length of the DRAM-resident string. Default: " << large_size << "." << endl <<
+	"-n <arg>    Number of operations per measure. Default: " << n_ops << "." << endl <<
+	"-r <arg>    Random seed. Default: " << seed << "." << endl;
+	exit(0);
+}
+
+/*
+ * positions for the benchmark: uniformly random in [0,n], or sequential (small random increments, wrapping around)
+ */
+vector<uint64_t> positions(uint64_t n, bool random){
+
+	mt19937_64 gen(seed);
+	vector<uint64_t> P(n_ops);
+
+	uint64_t p = 0;
+
+	for(auto & x : P){
+
+		if(random) x = gen()%(n+1);
+		else{
+
+			p += gen()%8;
+			if(p > n) p = 0;
+			x = p;
+
+		}
+
+	}
+
+	return P;
+
+}
+
+void row(string kernel, string layout, uint64_t n, bool random, double seconds, uint64_t checksum){
+
+	double ns = (seconds*1e9)/n_ops;
+
+	cout << kernel << "\t" << layout << "\t" << n << "\t" << (random ? "random" : "sequential") << "\t" <<
+			ns << "\t" << (n_ops/seconds)/1e6 << "\t" << checksum << endl;
+
+}
+
+template<class F>
+double time_it(F f){
+
+	auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+
+}
+
+/*
+ * sum of all components of a p_rank / p_rank_n: keeps the compiler from removing the measured calls
+ */
+uint64_t fold(p_rank r){ return r.A + r.C + r.G + r.T; }
+uint64_t fold(p_rank_n r){ return r.A + r.C + r.G + r.N + r.T; }
+uint64_t fold(p_range r){ return r.A.first + r.C.first + r.G.first + r.T.second; }
+uint64_t fold(p_range_n r){ return r.A.first + r.C.first + r.G.first + r.N.first + r.T.second; }
+uint64_t fold(p_node r){ return r.A.first_C + r.C.first_G + r.G.first_T + r.T.last; }
+uint64_t fold(p_node_n r){ return r.A.first_C + r.C.first_G + r.G.first_N + r.N.first_T + r.T.last; }
+
+/*
+ * node starting at position i whose children have lengths 0..7 (i.e. a node close to the leaves, as most suffix tree nodes)
+ */
+void make_node(uint64_t i, uint64_t n, sa_node & N){
+
+	N.first_TERM = std::min(n, i);
+	N.first_A = std::min(n, N.first_TERM + (i&7));
+	N.first_C = std::min(n, N.first_A + ((i>>3)&7));
+	N.first_G = std::min(n, N.first_C + ((i>>6)&7));
+	N.first_T = std::min(n, N.first_G + ((i>>9)&7));
+	N.last = std::min(n, N.first_T + ((i>>12)&7));
+	N.depth = 0;
+
+}
+
+void make_node(uint64_t i, uint64_t n, sa_node_n & N){
+
+	N.first_TERM = std::min(n, i);
+	N.first_A = std::min(n, N.first_TERM + (i&7));
+	N.first_C = std::min(n, N.first_A + ((i>>3)&7));
+	N.first_G = std::min(n, N.first_C + ((i>>6)&7));
+	N.first_N = std::min(n, N.first_G + ((i>>9)&7));
+	N.first_T = std::min(n, N.first_N + ((i>>12)&7));
+	N.last = std::min(n, N.first_T + ((i>>15)&7));
+	N.depth = 0;
+
+}
+
+template<class bwt_t>
+void bench_kernels(uint64_t n, string layout, string alphabet){
+
+	mt19937_64 gen(seed);
+
+	bwt_t BWT(n, [&](char * buf, uint64_t len){ for(uint64_t i=0;i<len;++i) buf[i] = alphabet[gen()%alphabet.size()]; });
+
+	for(bool random : {true, false}){
+
+		auto P = positions(n, random);
+		uint64_t check = 0;
+
+		double t = time_it([&](){ for(auto i : P) check += fold(BWT.parallel_rank(i)); });
+		row("parallel_rank", layout, n, random, t, check);
+
+		//ranges of length 0..63
+		check = 0;
+		t = time_it([&](){
+
+			for(auto i : P) check += fold(BWT.LF(range_t{i, std::min(n, i + (i&63))}));
+
+		});
+		row("LF(range_t)", layout, n, random, t, check);
+
+		check = 0;
+		t = time_it([&](){
+
+			for(auto i : P){
+
+				typename bwt_t::sa_node_t N;
+				make_node(i, n, N);
+
+				check += fold(BWT.LF(N));
+
+			}
+
+		});
+		row("LF(sa_node)", layout, n, random, t, check);
+
+	}
+
+}
+
+int main(int argc, char** argv){
+
+	int opt;
+	while ((opt = getopt(argc, argv, "hs:l:n:r:")) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 's':
+				small_size = atoll(optarg);
+			break;
+			case 'l':
+				large_size = atoll(optarg);
+			break;
+			case 'n':
+				n_ops = atoll(optarg);
+			break;
+			case 'r':
+				seed = atoll(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	cout << "kernel\tlayout\tn\tpositions\tns_per_op\tMops_per_s\tchecksum" << endl;
+
+	for(uint64_t n : {small_size, large_size}){
+
+		bench_kernels<dna_bwt_t>(n, "dna_string", "ACGT#");
+		bench_kernels<dna_bwt_n_t>(n, "dna_string_n", "ACGNT#");
+
+	}
+
+}
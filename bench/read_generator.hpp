@@ -0,0 +1,145 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * read_generator.hpp
+ *
+ *  Created on: Jan 14, 2019
+ *      Author: nico
+ *
+ *  Deterministic generator of short-read collections (reads sampled from a random genome, with substitution
+ *  errors and 'N's), and a simple in-memory suffix sort computing the eBWT of a collection.
+ *
+ *  The eBWT is the one expected by bwt2lcp and merge_bwt: suffixes W.TERM of all reads are sorted with
+ *  TERM < A < C < G < N < T, and equal suffixes are sorted by read index.
+ *
+ */
+
+#ifndef BENCH_READ_GENERATOR_HPP_
+#define BENCH_READ_GENERATOR_HPP_
+
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+struct read_collection_params{
+
+	uint64_t genome_length = 200000;
+	double coverage = 5;
+	uint64_t read_length = 100;
+	double error_rate = 0.01;//probability of a substitution at each base
+	double n_rate = 0;//probability of an 'N' at each base
+	uint64_t seed = 1;
+
+};
+
+/*
+ * generate the reads. The genome only depends on genome_length and genome_seed, so that collections generated
+ * with different seeds (but the same genome_seed) are samples of the same genome.
+ */
+vector<string> generate_reads(read_collection_params p, uint64_t genome_seed = 0){
+
+	const char DNA[4] = {'A','C','G','T'};
+
+	mt19937_64 gen_g(genome_seed);
+	string genome(p.genome_length,'A');
+	for(auto & c : genome) c = DNA[gen_g()%4];
+
+	mt19937_64 gen(p.seed);
+	uniform_real_distribution<double> coin(0,1);
+
+	uint64_t rl = std::min(p.read_length, p.genome_length);
+	uint64_t n_reads = uint64_t(p.coverage * p.genome_length / rl);
+
+	vector<string> reads(n_reads);
+
+	for(auto & r : reads){
+
+		r = genome.substr(gen()%(p.genome_length - rl + 1), rl);
+
+		for(auto & c : r){
+
+			if(coin(gen) < p.error_rate) c = DNA[gen()%4];
+			if(coin(gen) < p.n_rate) c = 'N';
+
+		}
+
+	}
+
+	return reads;
+
+}
+
+/*
+ * eBWT of the reads. TERM = terminator
+ */
+string ebwt(vector<string> & reads, char TERM = '#'){
+
+	//text = concatenation of the reads, each followed by a terminator (rank 0). Other ranks: A=1,C=2,G=3,N=4,T=5
+	vector<uint8_t> text;
+	vector<uint32_t> read_id;//read of each text position
+	vector<uint64_t> read_start;
+
+	uint8_t rank[256] = {};
+	rank['A'] = 1; rank['C'] = 2; rank['G'] = 3; rank['N'] = 4; rank['T'] = 5;
+
+	for(uint64_t r = 0; r < reads.size(); ++r){
+
+		read_start.push_back(text.size());
+
+		for(auto c : reads[r]){
+
+			text.push_back(rank[uint8_t(c)]);
+			read_id.push_back(r);
+
+		}
+
+		text.push_back(0);
+		read_id.push_back(r);
+
+	}
+
+	vector<uint64_t> SA(text.size());
+	for(uint64_t i = 0; i < SA.size(); ++i) SA[i] = i;
+
+	std::sort(SA.begin(), SA.end(), [&](uint64_t a, uint64_t b){
+
+		while(text[a] == text[b] and text[a] != 0){ a++; b++; }
+
+		if(text[a] != text[b]) return text[a] < text[b];
+
+		return read_id[a] < read_id[b];
+
+	});
+
+	const char ascii[6] = {TERM,'A','C','G','N','T'};
+
+	string bwt(SA.size(), TERM);
+
+	for(uint64_t i = 0; i < SA.size(); ++i){
+
+		uint64_t j = SA[i];
+
+		//the character preceding the first suffix of a read is the terminator
+		if(j != read_start[read_id[j]]) bwt[i] = ascii[text[j-1]];
+
+	}
+
+	return bwt;
+
+}
+
+void save_string(string path, string & s){
+
+	ofstream out(path);
+	out.write(s.data(), s.size());
+	out.close();
+
+}
+
+#endif /* BENCH_READ_GENERATOR_HPP_ */
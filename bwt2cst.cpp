@@ -0,0 +1,208 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt2cst.cpp
+ *
+ *  Created on: Jan 24, 2019
+ *      Author: nico
+ */
+
+#include <iostream>
+#include "internal/lcp.hpp"
+#include "internal/cst.hpp"
+#include <unistd.h>
+#include <getopt.h>
+#include "internal/dna_bwt_n.hpp"
+
+using namespace std;
+
+string input_bwt;
+string output_file;
+
+uint8_t lcp_size = 4;
+
+bool containsN = false;
+
+char TERM = '#';
+
+uint64_t n_threads = 0;
+
+string stats_json;
+
+void help(){
+
+	cout << "bwt2cst [options]" << endl <<
+	"Input: BWT of a collection of reads. Output: compressed suffix tree of the collection: LCP array (prefix.lcp)," << endl <<
+	"balanced parentheses of the suffix tree topology (prefix.bps) and range-minimum directory on the LCP (prefix.rmq)." << endl <<
+	"The three files can be memory mapped with class cst (internal/cst.hpp)." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-i <arg>    Input BWT: ASCII file or packed index (.dbwt) written by merge_bwt -x (REQUIRED)" << endl <<
+	"-o <arg>    Output prefix (REQUIRED)" << endl <<
+	"-l <arg>    Number of Bytes used to represent LCP values. <arg>=1,2,4,8 Bytes. Default: 4." << endl <<
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads used to format and write the output. Default: number of hardware threads." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
+	exit(0);
+}
+
+/*
+ * load the BWT, compute its LCP using lcp_int_t integers, build topology and directory and store them.
+ */
+template<class bwt_t, typename lcp_int_t>
+void run(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWT ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT = bwt_t(input_bwt, TERM);
+
+	stats.end_phase(BWT.size());
+
+	cout << "Done. Size of BWT: " << BWT.size()<< endl;
+
+	lcp<bwt_t, lcp_int_t> M(&BWT);
+
+	stats.append(M.stats);
+
+	cout << "\nBuilding suffix tree topology and range-minimum directory ... " << endl;
+
+	stats.begin_phase("cst");
+
+	cst_builder<lcp_int_t> C(M.LCP.data(), M.LCP.size());
+
+	stats.end_phase(M.LCP.size());
+
+	cout << "Done. Number of internal nodes: " << C.number_of_nodes() << endl;
+
+	cout << "Storing output to files ... " << endl;
+
+	stats.begin_phase("save");
+
+	uint64_t bytes = M.LCP.size()*sizeof(lcp_int_t);
+
+	{
+
+		output_writer out(n_threads);
+
+		out.write_raw(output_file + ".lcp", M.LCP.data(), bytes);
+		bytes += C.save(output_file, out);
+
+		out.wait();
+
+	}
+
+	stats.end_phase(M.LCP.size());
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("bwt2cst"));
+	stats.set("input", input_bwt);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("lcp_bytes", sizeof(lcp_int_t));
+	stats.set("bytes_read", uint64_t(filesize(input_bwt)));
+	stats.set("bytes_written", bytes);
+	stats.set("internal_nodes", C.number_of_nodes());
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	switch(lcp_size){
+
+		case 1: run<bwt_t, uint8_t>(alphabet); break;
+		case 2: run<bwt_t, uint16_t>(alphabet); break;
+		case 4: run<bwt_t, uint32_t>(alphabet); break;
+		case 8: run<bwt_t, uint64_t>(alphabet); break;
+		default:break;
+
+	}
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3) help();
+
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "hi:o:l:t:p:j:", long_options, NULL)) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'i':
+				input_bwt = string(optarg);
+			break;
+			case 'o':
+				output_file = string(optarg);
+			break;
+			case 'l':
+				lcp_size = atoi(optarg);
+			break;
+			case 't':
+				TERM = atoi(optarg);
+			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	if(lcp_size != 1 and lcp_size != 2 and lcp_size != 4 and lcp_size != 8) help();
+
+	if(TERM == 'A' or TERM == 'C' or TERM == 'G' or TERM == 'T' or TERM == 'N'){
+
+		cout << "Error: invalid terminator '" << TERM << "'" << endl;
+		help();
+
+	}
+
+	if(input_bwt.size()==0) help();
+	if(output_file.size()==0) help();
+
+	cout << "Input bwt file: " << input_bwt << endl;
+	cout << "Output prefix: " << output_file << endl;
+
+	progress::install_handler();//SIGUSR1: print current counters
+
+	containsN = hasN(input_bwt);
+
+	if(not containsN){
+
+		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_t>("ACGT");
+
+	}else{
+
+		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_n_t>("ACGNT");
+
+	}
+
+	cout << "Done. " << endl;
+
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt2dbg.cpp
+ *
+ *  Created on: Jan 28, 2019
+ *      Author: nico
+ */
+
+#include <iostream>
+#include "internal/dbg.hpp"
+#include <unistd.h>
+#include <getopt.h>
+#include "internal/dna_bwt.hpp"
+#include "internal/dna_bwt_n.hpp"
+
+using namespace std;
+
+string input_bwt;
+string output_file;
+
+uint64_t k = 0;
+uint64_t min_count = 1;
+
+bool boss = false;
+
+bool containsN = false;
+
+char TERM = '#';
+
+uint64_t n_threads = 0;
+
+string stats_json;
+
+void help(){
+
+	cout << "bwt2dbg [options]" << endl <<
+	"Input: BWT of a collection of reads. Output: de Bruijn graph of order k of the collection (see internal/dbg.hpp):" << endl <<
+	"nodes (prefix.nodes) and edges (prefix.edges) with their counts, or a BOSS-style succinct representation (prefix.boss)." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-i <arg>    Input BWT: ASCII file or packed index (.dbwt) written by merge_bwt -x (REQUIRED)" << endl <<
+	"-o <arg>    Output prefix (REQUIRED)" << endl <<
+	"-k <arg>    Order of the graph (length of the node k-mers), 1 <= <arg> <= " << DBG_MAX_K << " (REQUIRED)" << endl <<
+	"-c <arg>    Keep only nodes and edges occurring at least <arg> times. Default: 1." << endl <<
+	"-b          Store the BOSS representation instead of nodes and edges (16 Bytes of RAM per node to sort them)." << endl <<
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads. Default: number of hardware threads." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
+	exit(0);
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWT ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT = bwt_t(input_bwt, TERM);
+
+	stats.end_phase(BWT.size());
+
+	cout << "Done. Size of BWT: " << BWT.size()<< endl;
+
+	dbg_builder<bwt_t> G(&BWT, k, min_count, boss, output_file, n_threads);
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("bwt2dbg"));
+	stats.set("input", input_bwt);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("n", BWT.size());
+	stats.set("bytes_read", uint64_t(filesize(input_bwt)));
+	stats.append(G.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3) help();
+
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "hi:o:k:c:bt:p:j:", long_options, NULL)) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'i':
+				input_bwt = string(optarg);
+			break;
+			case 'o':
+				output_file = string(optarg);
+			break;
+			case 'k':
+				k = atoll(optarg);
+			break;
+			case 'c':
+				min_count = atoll(optarg);
+			break;
+			case 'b':
+				boss = true;
+			break;
+			case 't':
+				TERM = atoi(optarg);
+			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	if(TERM == 'A' or TERM == 'C' or TERM == 'G' or TERM == 'T' or TERM == 'N'){
+
+		cout << "Error: invalid terminator '" << TERM << "'" << endl;
+		help();
+
+	}
+
+	if(input_bwt.size()==0) help();
+	if(output_file.size()==0) help();
+	if(k == 0 or k > DBG_MAX_K) help();
+	if(min_count == 0) help();
+
+	cout << "Input bwt file: " << input_bwt << endl;
+	cout << "Output prefix: " << output_file << endl;
+
+	progress::install_handler();//SIGUSR1: print current counters
+
+	containsN = hasN(input_bwt);
+
+	if(not containsN){
+
+		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_t>("ACGT");
+
+	}else{
+
+		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_n_t>("ACGNT");
+
+	}
+
+	cout << "Done. " << endl;
+
+}
@@ -0,0 +1,180 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt2kmers.cpp
+ *
+ *  Created on: Jan 27, 2019
+ *      Author: nico
+ */
+
+#include <iostream>
+#include "internal/kmer_counter.hpp"
+#include <unistd.h>
+#include <getopt.h>
+#include "internal/dna_bwt.hpp"
+#include "internal/dna_bwt_n.hpp"
+
+using namespace std;
+
+string input_bwt;
+string output_file;
+
+uint64_t k = 0;
+uint64_t min_count = 1;
+
+bool histogram = false;
+bool lexicographic_order = false;
+
+bool containsN = false;
+
+char TERM = '#';
+
+uint64_t n_threads = 0;
+
+string stats_json;
+
+void help(){
+
+	cout << "bwt2kmers [options]" << endl <<
+	"Input: BWT of a collection of reads. Output: the distinct k-mers of the collection (over A,C,G,T) with their" << endl <<
+	"number of occurrences, in binary form (see internal/kmer_counter.hpp), or the histogram of the counts." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-i <arg>    Input BWT: ASCII file or packed index (.dbwt) written by merge_bwt -x (REQUIRED)" << endl <<
+	"-o <arg>    Output file name (REQUIRED)" << endl <<
+	"-k <arg>    k-mer length, 1 <= <arg> <= " << KMC_MAX_K << " (REQUIRED)" << endl <<
+	"-c <arg>    Report only k-mers occurring at least <arg> times (rarer ones are not navigated). Default: 1." << endl <<
+	"-H          Output only the histogram: ASCII lines 'count<TAB>number of k-mers with that count'." << endl <<
+	"-l          Sort the k-mers in lexicographic order before writing them: the records are kept in RAM (16 Bytes per" << endl <<
+	"            k-mer). Default: Weiner order (colexicographic), streamed with no memory on top of the BWT." << endl <<
+	"-w          Weiner order (the default; kept for compatibility)." << endl <<
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads. Default: number of hardware threads." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
+	exit(0);
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWT ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT = bwt_t(input_bwt, TERM);
+
+	stats.end_phase(BWT.size());
+
+	cout << "Done. Size of BWT: " << BWT.size()<< endl;
+
+	auto order = lexicographic_order ? kmer_counter<bwt_t>::lexicographic : kmer_counter<bwt_t>::weiner;
+
+	kmer_counter<bwt_t> C(&BWT, k, min_count, order, histogram, output_file, n_threads);
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("bwt2kmers"));
+	stats.set("input", input_bwt);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("n", BWT.size());
+	stats.set("bytes_read", uint64_t(filesize(input_bwt)));
+	stats.append(C.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3) help();
+
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "hi:o:k:c:Hlwt:p:j:", long_options, NULL)) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'i':
+				input_bwt = string(optarg);
+			break;
+			case 'o':
+				output_file = string(optarg);
+			break;
+			case 'k':
+				k = atoll(optarg);
+			break;
+			case 'c':
+				min_count = atoll(optarg);
+			break;
+			case 'H':
+				histogram = true;
+			break;
+			case 'l':
+				lexicographic_order = true;
+			break;
+			case 'w':
+				lexicographic_order = false;
+			break;
+			case 't':
+				TERM = atoi(optarg);
+			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	if(TERM == 'A' or TERM == 'C' or TERM == 'G' or TERM == 'T' or TERM == 'N'){
+
+		cout << "Error: invalid terminator '" << TERM << "'" << endl;
+		help();
+
+	}
+
+	if(input_bwt.size()==0) help();
+	if(output_file.size()==0) help();
+	if(k == 0 or k > KMC_MAX_K) help();
+	if(min_count == 0) help();
+
+	cout << "Input bwt file: " << input_bwt << endl;
+	cout << "Output file: " << output_file << endl;
+
+	progress::install_handler();//SIGUSR1: print current counters
+
+	containsN = hasN(input_bwt);
+
+	if(not containsN){
+
+		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_t>("ACGT");
+
+	}else{
+
+		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_n_t>("ACGNT");
+
+	}
+
+	cout << "Done. " << endl;
+
+}
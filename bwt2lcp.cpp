@@ -13,6 +13,7 @@
 #include <iostream>
 #include "internal/lcp.hpp"
 #include <unistd.h>
+#include <getopt.h>
 #include "internal/dna_bwt_n.hpp"
 
 using namespace std;
@@ -27,26 +28,140 @@ bool containsN = false;
 
 char TERM = '#';
 
+uint64_t n_threads = 0;
+
+string stats_json;
+
+uint64_t ckpt_seconds = 0;
+bool resume = false;
+
+bool mmap_output = false;
+bool compress_lcp = false;
+
+uint64_t depth_cap = 0;
+
+bool run_sampled = false;
+
+bool save_sus = false;
+uint64_t min_repeat = 0;
+
 void help(){
 
 	cout << "bwt2lcp [options]" << endl <<
 	"Input: BWT of a collection of reads. Output: LCP array of the collection." << endl <<
 	"Options:" << endl <<
 	"-h          Print this help" << endl <<
-	"-i <arg>    Input BWT (REQUIRED)" << endl <<
+	"-i <arg>    Input BWT: ASCII file or packed index (.dbwt) written by merge_bwt -x (REQUIRED)" << endl <<
 	"-o <arg>    Output file name (REQUIRED)" << endl <<
 	"-l <arg>    Number of Bytes used to represent LCP values. <arg>=1,2,4,8 Bytes. Default: 1." << endl <<
 	//"-n          Alphabet is {A,C,G,N,T," << TERM << "}. Default: alphabet is {A,C,G,T," << TERM << "}."<< endl <<
-	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl;
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads used to format and write the output. Default: number of hardware threads." << endl <<
+	"-m          Build the LCP directly in the output file (memory mapped) instead of in RAM: no final copy, and the" << endl <<
+	"            kernel can page it out under memory pressure." << endl <<
+	"-K <arg>    Compute min(LCP, <arg>) instead of the LCP: suffix tree nodes deeper than <arg> are not visited (much" << endl <<
+	"            faster on deep, repetitive inputs). <arg> must be smaller than 2^(8*B)-1, B = Bytes per LCP value. Default: no cap." << endl <<
+	"-z          Store the LCP in compressed form (blocks of bit-packed differences from the block minimum), with random" << endl <<
+	"            access to single values (see internal/compressed_lcp.hpp). Not compatible with -m." << endl <<
+	"-s          (--run-sampled) Compute only the LCP values at the run boundaries of the BWT (position 0, and positions" << endl <<
+	"            i-1, i for each i with BWT[i] != BWT[i-1]), in RAM proportional to the number of runs instead of n*B." << endl <<
+	"            The output file contains the sampled values and file <output>.pos their positions (8-Byte integers)." << endl <<
+	"            Not compatible with -m, -z, -c, -r." << endl <<
+	"-S          (--sus) Also store to file <output>.sus the shortest unique substring lengths: for each BWT position i," << endl <<
+	"            1 + max(LCP[i], LCP[i+1]) (same width as the LCP), computed from the LCP in memory. Not compatible with -s." << endl <<
+	"-R <arg>    (--repeats <arg>) Also store to file <output>.rep the maximal repeats of length >= <arg>, with their number" << endl <<
+	"            of occurrences and BWT intervals (see internal/lcp.hpp). Not compatible with -K, -c, -r." << endl <<
+	"-c <arg>    Save a checkpoint every <arg> seconds (files with extension .ckpt*, next to the output). Default: no checkpoints." << endl <<
+	"-r          (--resume) Resume from the last checkpoint of a previous run with the same inputs, options and output." << endl <<
+	"            If -c is not given, checkpoints are saved every " << CHECKPOINT_DEFAULT_SECONDS << " seconds." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
 	exit(0);
 }
 
+/*
+ * load the BWT, compute its LCP using lcp_int_t integers and store it. Global statistics of the run
+ * (including BWT loading) are saved to stats_json, if set.
+ */
+template<class bwt_t, typename lcp_int_t>
+void run(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWT ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT = bwt_t(input_bwt, TERM);
+
+	stats.end_phase(BWT.size());
+
+	cout << "Done. Size of BWT: " << BWT.size()<< endl;
+
+	lcp_options opt;
+
+	opt.ckpt_path = ckpt_seconds > 0 ? output_file : "";
+	opt.ckpt_seconds = ckpt_seconds;
+	opt.resume = resume;
+	opt.lcp_path = mmap_output ? output_file : "";
+	opt.depth_cap = depth_cap;
+	opt.run_sampled = run_sampled;
+	opt.repeats_path = min_repeat > 0 ? output_file + ".rep" : "";
+	opt.min_repeat = min_repeat;
+
+	lcp<bwt_t, lcp_int_t> M(&BWT, opt);
+
+	//from the LCP in memory, before save_to_file removes the checkpoint files backing it
+	if(save_sus) M.save_sus(output_file + ".sus", n_threads);
+
+	cout << "Storing output to file ... " << endl;
+	M.save_to_file(output_file, n_threads, compress_lcp);
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("bwt2lcp"));
+	stats.set("input", input_bwt);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("lcp_bytes", sizeof(lcp_int_t));
+	stats.set("bytes_read", uint64_t(filesize(input_bwt)));
+	stats.append(M.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	switch(lcp_size){
+
+		case 1: run<bwt_t, uint8_t>(alphabet); break;
+		case 2: run<bwt_t, uint16_t>(alphabet); break;
+		case 4: run<bwt_t, uint32_t>(alphabet); break;
+		case 8: run<bwt_t, uint64_t>(alphabet); break;
+		default:break;
+
+	}
+
+}
+
 int main(int argc, char** argv){
 
 	if(argc < 3) help();
 
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{"resume", no_argument, 0, 'r'},
+		{"run-sampled", no_argument, 0, 's'},
+		{"sus", no_argument, 0, 'S'},
+		{"repeats", required_argument, 0, 'R'},
+		{0, 0, 0, 0}
+	};
+
 	int opt;
-	while ((opt = getopt(argc, argv, "hi:o:l:t:")) != -1){
+	while ((opt = getopt_long(argc, argv, "hi:o:l:t:p:j:c:rmzK:sSR:", long_options, NULL)) != -1){
 		switch (opt){
 			case 'h':
 				help();
@@ -63,6 +178,37 @@ int main(int argc, char** argv){
 			case 't':
 				TERM = atoi(optarg);
 			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			case 'c':
+				ckpt_seconds = atoll(optarg);
+			break;
+			case 'r':
+				resume = true;
+			break;
+			case 'm':
+				mmap_output = true;
+			break;
+			case 'z':
+				compress_lcp = true;
+			break;
+			case 'K':
+				depth_cap = atoll(optarg);
+			break;
+			case 's':
+				run_sampled = true;
+			break;
+			case 'S':
+				save_sus = true;
+			break;
+			case 'R':
+				min_repeat = atoll(optarg);
+				if(min_repeat == 0) help();
+			break;
 			/*case 'n':
 				containsN=true;
 			break;*/
@@ -87,75 +233,61 @@ int main(int argc, char** argv){
 	cout << "Input bwt file: " << input_bwt << endl;
 	cout << "Output LCP file: " << output_file << endl;
 
-	containsN = hasN(input_bwt);
+	if(depth_cap > 0 and (lcp_size == 0 or (lcp_size < 8 and depth_cap >= (uint64_t(1) << (8*lcp_size)) - 1))){
 
-	if(not containsN){
+		cout << "Error: the depth cap (-K) requires an LCP width (-l) able to represent it" << endl;
+		help();
 
-		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+	}
 
-		cout << "Loading and indexing BWT ... " << endl;
+	if(mmap_output and compress_lcp){
 
-		dna_bwt_t BWT = dna_bwt_t(input_bwt, TERM);
+		cout << "Error: options -m and -z cannot be used together" << endl;
+		help();
 
-		cout << "Done. Size of BWT: " << BWT.size()<< endl;
+	}
 
-		switch(lcp_size){
+	if(run_sampled and (mmap_output or compress_lcp or ckpt_seconds > 0 or resume)){
 
-			case 1: { lcp<dna_bwt_t, uint8_t> M1(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M1.save_to_file(output_file);
-					break; }
-			case 2: { lcp<dna_bwt_t, uint16_t> M2(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M2.save_to_file(output_file);
-					break; }
-			case 4: { lcp<dna_bwt_t, uint32_t> M4(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M4.save_to_file(output_file);
-					break; }
-			case 8: { lcp<dna_bwt_t, uint64_t> M8(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M8.save_to_file(output_file);
-					break; }
-			default:break;
+		cout << "Error: option -s cannot be used together with -m, -z, -c, -r" << endl;
+		help();
 
-		}
+	}
 
-	}else{
+	if(save_sus and run_sampled){
 
-		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+		cout << "Error: options -S and -s cannot be used together" << endl;
+		help();
 
-		cout << "Loading and indexing BWT ... " << endl;
+	}
 
-		dna_bwt_n_t BWT = dna_bwt_n_t(input_bwt, TERM);
+	if(min_repeat > 0 and (depth_cap > 0 or ckpt_seconds > 0 or resume)){
 
-		cout << "Done. Size of BWT: " << BWT.size()<< endl;
+		cout << "Error: option -R cannot be used together with -K, -c, -r" << endl;
+		help();
 
-		switch(lcp_size){
+	}
 
-			case 1: { lcp<dna_bwt_n_t, uint8_t> M1(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M1.save_to_file(output_file);
-					break; }
-			case 2: { lcp<dna_bwt_n_t, uint16_t> M2(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M2.save_to_file(output_file);
-					break; }
-			case 4: { lcp<dna_bwt_n_t, uint32_t> M4(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M4.save_to_file(output_file);
-					break; }
-			case 8: { lcp<dna_bwt_n_t, uint64_t> M8(&BWT);
-					cout << "Storing output to file ... " << endl;
-					M8.save_to_file(output_file);
-					break; }
-			default:break;
+	if(resume and ckpt_seconds == 0) ckpt_seconds = CHECKPOINT_DEFAULT_SECONDS;
 
-		}
+	progress::install_handler();//SIGUSR1: print current counters
+
+	containsN = hasN(input_bwt);
+
+	if(not containsN){
+
+		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_t>("ACGT");
+
+	}else{
+
+		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_n_t>("ACGNT");
 
 	}
 
 	cout << "Done. " << endl;
 
 }
-
@@ -0,0 +1,157 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt2overlaps.cpp
+ *
+ *  Created on: Jan 26, 2019
+ *      Author: nico
+ */
+
+#include <iostream>
+#include "internal/overlap_graph.hpp"
+#include <unistd.h>
+#include <getopt.h>
+#include "internal/dna_bwt.hpp"
+#include "internal/dna_bwt_n.hpp"
+
+using namespace std;
+
+string input_bwt;
+string output_file;
+
+uint64_t tau = 0;
+
+bool containsN = false;
+
+char TERM = '#';
+
+uint64_t n_threads = 0;
+
+string stats_json;
+
+void help(){
+
+	cout << "bwt2overlaps [options]" << endl <<
+	"Input: eBWT of a collection of reads. Output: for each pair of distinct reads i, j, the longest suffix of read i" << endl <<
+	"of length l >= tau that is a prefix of read j (containments excluded), as a stream of edges (i, j, l) in compact" << endl <<
+	"binary form (see internal/overlap_graph.hpp). Read i is the read of the i-th terminator of the eBWT." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-i <arg>    Input BWT: ASCII file or packed index (.dbwt) written by merge_bwt -x (REQUIRED)" << endl <<
+	"-o <arg>    Output file name (REQUIRED)" << endl <<
+	"-L <arg>    Minimum overlap length tau >= 1 (REQUIRED)" << endl <<
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads. Default: number of hardware threads." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
+	exit(0);
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWT ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT = bwt_t(input_bwt, TERM);
+
+	stats.end_phase(BWT.size());
+
+	cout << "Done. Size of BWT: " << BWT.size()<< endl;
+
+	overlap_graph<bwt_t> G(&BWT, tau, output_file, n_threads);
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("bwt2overlaps"));
+	stats.set("input", input_bwt);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("n", BWT.size());
+	stats.set("bytes_read", uint64_t(filesize(input_bwt)));
+	stats.append(G.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3) help();
+
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "hi:o:L:t:p:j:", long_options, NULL)) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'i':
+				input_bwt = string(optarg);
+			break;
+			case 'o':
+				output_file = string(optarg);
+			break;
+			case 'L':
+				tau = atoll(optarg);
+			break;
+			case 't':
+				TERM = atoi(optarg);
+			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	if(TERM == 'A' or TERM == 'C' or TERM == 'G' or TERM == 'T' or TERM == 'N'){
+
+		cout << "Error: invalid terminator '" << TERM << "'" << endl;
+		help();
+
+	}
+
+	if(input_bwt.size()==0) help();
+	if(output_file.size()==0) help();
+	if(tau == 0) help();
+
+	cout << "Input bwt file: " << input_bwt << endl;
+	cout << "Output file: " << output_file << endl;
+
+	progress::install_handler();//SIGUSR1: print current counters
+
+	containsN = hasN(input_bwt);
+
+	if(not containsN){
+
+		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_t>("ACGT");
+
+	}else{
+
+		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
+
+		run<dna_bwt_n_t>("ACGNT");
+
+	}
+
+	cout << "Done. " << endl;
+
+}
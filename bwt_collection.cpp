@@ -0,0 +1,137 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt_collection.cpp
+ *
+ *  Created on: Jan 10, 2019
+ *      Author: nico
+ */
+
+#include <iostream>
+#include "internal/bwt_collection.hpp"
+#include <unistd.h>
+
+using namespace std;
+
+string collection_dir;
+string input_batch;
+string output_file;
+
+bool status = false;
+bool containsN = false;
+
+uint64_t base = 1<<26;
+uint64_t fanout = 4;
+
+char TERM = '#';
+
+void help(){
+
+	cout << "bwt_collection [options]" << endl <<
+	"Incremental eBWT collection: new batches are merged into a few levels of packed BWTs (LSM-tree style)," << endl <<
+	"so that the amortized cost of adding a batch is logarithmic in the collection size." << endl <<
+	"Options:" << endl <<
+	"-h          Print this help" << endl <<
+	"-c <arg>    Collection directory. Created if it does not exist (REQUIRED)" << endl <<
+	"-a <arg>    Add batch: eBWT of the new reads (ASCII file or packed index)" << endl <<
+	"-e <arg>    Export the eBWT of the whole collection as packed index <arg>.dbwt (input for bwt2lcp/merge_bwt)" << endl <<
+	"-s          Print the levels of the collection" << endl <<
+	"-n          When creating the collection, use alphabet {A,C,G,N,T," << TERM << "} even if the first batch has no 'N'." << endl <<
+	"-b <arg>    When creating the collection, capacity (characters) of level 0. Default: " << base << "." << endl <<
+	"-f <arg>    When creating the collection, capacity ratio between consecutive levels. Default: " << fanout << "." << endl <<
+	"-t          ASCII code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl;
+	exit(0);
+}
+
+template<class bwt_t>
+void run(){
+
+	bwt_collection<bwt_t> C(collection_dir, TERM, base, fanout);
+
+	if(input_batch.size()>0) C.add(input_batch);
+
+	if(output_file.size()>0){
+
+		bwt_t BWT = C.merge_all();
+
+		cout << "Storing collection eBWT (" << BWT.size() << " characters) to " << output_file << ".dbwt ... " << endl;
+		BWT.save_to_file(output_file + ".dbwt");
+
+	}
+
+	if(status) C.print();
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3) help();
+
+	int opt;
+	while ((opt = getopt(argc, argv, "hc:a:e:snb:f:t:")) != -1){
+		switch (opt){
+			case 'h':
+				help();
+			break;
+			case 'c':
+				collection_dir = string(optarg);
+			break;
+			case 'a':
+				input_batch = string(optarg);
+			break;
+			case 'e':
+				output_file = string(optarg);
+			break;
+			case 's':
+				status = true;
+			break;
+			case 'n':
+				containsN = true;
+			break;
+			case 'b':
+				base = atoll(optarg);
+			break;
+			case 'f':
+				fanout = atoll(optarg);
+			break;
+			case 't':
+				TERM = atoi(optarg);
+			break;
+			default:
+				help();
+			return -1;
+		}
+	}
+
+	if(TERM == 'A' or TERM == 'C' or TERM == 'G' or TERM == 'T' or TERM == 'N'){
+
+		cout << "Error: invalid terminator '" << TERM << "'" << endl;
+		help();
+
+	}
+
+	if(collection_dir.size()==0) help();
+
+	progress::install_handler();//SIGUSR1: print current counters
+
+	uint8_t sigma = bwt_collection<dna_bwt_t>::alphabet(collection_dir);
+
+	bool batchN = input_batch.size()>0 and hasN(input_batch);
+
+	if(sigma == 0) sigma = (containsN or batchN) ? 6 : 5;
+
+	if(sigma == 5 and batchN){
+
+		cout << "Error: the batch contains 'N' characters, but the collection alphabet is A,C,G,T,'" << TERM << "'." << endl;
+		exit(1);
+
+	}
+
+	if(sigma == 5) run<dna_bwt_t>();
+	else run<dna_bwt_n_t>();
+
+	cout << "Done. " << endl;
+
+}
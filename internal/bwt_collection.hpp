@@ -0,0 +1,352 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * bwt_collection.hpp
+ *
+ *  Created on: Jan 10, 2019
+ *      Author: nico
+ *
+ * Incremental collection of read batches stored as a few levels of packed BWT indexes (LSM-tree style).
+ *
+ * Level i holds at most one packed BWT of at most base*fanout^i characters. A new batch is merged into the smallest
+ * level; when a level overflows, its BWT is merged with the next level (tiered cascade). Each character is therefore
+ * re-merged O(log_fanout(n/base)) times, instead of once per batch.
+ *
+ * The collection is a directory containing the level files and a text MANIFEST:
+ *
+ *   alphabet <5 or 6>
+ *   term <ASCII code of the terminator>
+ *   base <capacity of level 0>
+ *   fanout <capacity ratio between consecutive levels>
+ *   generation <counter used to name new level files>
+ *   level <i> <file name> <BWT length>     (one line per non-empty level)
+ *
+ * Level files are never modified: merges write new files, then the manifest is atomically replaced (rename) and
+ * only then obsolete files are removed. New level files and the new manifest are flushed to disk (fsync) before the
+ * rename, and the directory after it, so that also after a crash the manifest points to complete level files.
+ * Readers that open the manifest always see a consistent set of levels.
+ *
+ */
+
+#ifndef INTERNAL_BWT_COLLECTION_HPP_
+#define INTERNAL_BWT_COLLECTION_HPP_
+
+#include "bwt_merger.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <type_traits>
+
+using namespace std;
+
+template<class bwt_t>
+class bwt_collection{
+
+public:
+
+	struct level_t{
+
+		string file;//file name, relative to the collection directory. Empty if level is empty
+		uint64_t size;//BWT length
+
+	};
+
+	/*
+	 * open the collection stored in directory dir. If it does not exist, create it with the given parameters.
+	 */
+	bwt_collection(string dir, char TERM = '#', uint64_t base = 1<<26, uint64_t fanout = 4){
+
+		this->dir = dir;
+
+		if(not load_manifest()){
+
+			mkdir(dir.c_str(), 0755);
+
+			this->TERM = TERM;
+			this->base = base;
+			this->fanout = fanout < 2 ? 2 : fanout;
+
+			save_manifest();
+
+		}
+
+	}
+
+	/*
+	 * alphabet size stored in the manifest of collection dir: 5 = {A,C,G,T,TERM}, 6 = {A,C,G,N,T,TERM}. 0 if there is no collection.
+	 */
+	static uint8_t alphabet(string dir){
+
+		ifstream in(dir + "/MANIFEST");
+
+		string key;
+		int sigma = 0;
+
+		if(in >> key >> sigma and key == "alphabet") return sigma;
+
+		return 0;
+
+	}
+
+	/*
+	 * add a batch (ASCII BWT or packed index) to the collection
+	 */
+	void add(string batch_path){
+
+		cout << "Loading batch " << batch_path << " ... " << endl;
+
+		bwt_t carry(batch_path, TERM);
+
+		//a packed index carries its own terminator
+		if(carry.terminator() != TERM){
+
+			cout << "Error: the terminator of batch " << batch_path << " (ASCII code " << int(carry.terminator()) <<
+					") differs from the terminator of collection " << dir << " (ASCII code " << int(TERM) << ")" << endl;
+			exit(1);
+
+		}
+
+		cout << "Done. Size of batch: " << carry.size() << endl;
+
+		vector<string> obsolete;
+
+		uint64_t i = 0;
+
+		while(true){
+
+			if(i == levels.size()) levels.push_back({"",0});
+
+			if(levels[i].file.size() > 0){
+
+				//level i is not empty: merge it (older suffixes first) with the carry
+				cout << "Merging level " << i << " (" << levels[i].size << " characters) with " << carry.size() << " characters ... " << endl;
+
+				bwt_t old(dir + "/" + levels[i].file);
+
+				bwt_merger<bwt_t, uint8_t> M(&old, &carry);
+				carry = M.merged_bwt();
+
+				obsolete.push_back(levels[i].file);
+				levels[i] = {"",0};
+
+			}
+
+			if(carry.size() <= capacity(i)) break;
+
+			++i;
+
+		}
+
+		string file = "L" + to_string(i) + "." + to_string(generation++) + ".dbwt";
+
+		carry.save_to_file(dir + "/" + file);
+		sync_file(dir + "/" + file);
+
+		levels[i] = {file, carry.size()};
+
+		save_manifest();
+
+		for(auto f : obsolete) remove((dir + "/" + f).c_str());
+
+		cout << "Batch stored in level " << i << "." << endl;
+
+	}
+
+	/*
+	 * merge all levels and return the BWT of the whole collection. Older (larger) levels come first.
+	 */
+	bwt_t merge_all(){
+
+		bwt_t acc;
+		bool empty = true;
+
+		for(int64_t i = int64_t(levels.size())-1; i >= 0; --i){
+
+			if(levels[i].file.size() == 0) continue;
+
+			bwt_t L(dir + "/" + levels[i].file);
+
+			if(empty){
+
+				acc = std::move(L);
+				empty = false;
+
+			}else{
+
+				cout << "Merging level " << i << " ... " << endl;
+
+				bwt_merger<bwt_t, uint8_t> M(&acc, &L);
+				acc = M.merged_bwt();
+
+			}
+
+		}
+
+		return acc;
+
+	}
+
+	void print(){
+
+		cout << "Collection " << dir << ": alphabet size " << int(sigma()) << ", terminator " << int(TERM) <<
+				", level capacities " << base << "*" << fanout << "^i" << endl;
+
+		uint64_t tot = 0;
+
+		for(uint64_t i = 0; i < levels.size(); ++i){
+
+			if(levels[i].file.size() == 0) continue;
+
+			cout << "level " << i << ": " << levels[i].file << ", " << levels[i].size << "/" << capacity(i) << " characters" << endl;
+			tot += levels[i].size;
+
+		}
+
+		cout << "Total size: " << tot << " characters" << endl;
+
+	}
+
+	vector<level_t> levels;
+
+private:
+
+	uint8_t sigma(){
+		return std::is_same<bwt_t, dna_bwt_n_t>::value ? 6 : 5;
+	}
+
+	uint64_t capacity(uint64_t i){
+
+		uint64_t c = base;
+		for(uint64_t j = 0; j < i; ++j) c *= fanout;
+		return c;
+
+	}
+
+	/*
+	 * return false if there is no manifest in dir
+	 */
+	bool load_manifest(){
+
+		ifstream in(dir + "/MANIFEST");
+
+		if(not in.is_open()) return false;
+
+		string line;
+
+		while(getline(in, line)){
+
+			istringstream ss(line);
+			string key;
+			ss >> key;
+
+			if(key == "alphabet"){
+
+				int s; ss >> s;
+
+				if(s != sigma()){
+
+					cout << "Error: collection " << dir << " has alphabet size " << s << endl;
+					exit(1);
+
+				}
+
+			}
+			else if(key == "term"){ int t; ss >> t; TERM = t; }
+			else if(key == "base") ss >> base;
+			else if(key == "fanout") ss >> fanout;
+			else if(key == "generation") ss >> generation;
+			else if(key == "level"){
+
+				uint64_t i;
+				level_t L;
+				ss >> i >> L.file >> L.size;
+
+				if(levels.size() <= i) levels.resize(i+1, {"",0});
+				levels[i] = L;
+
+			}
+
+		}
+
+		return true;
+
+	}
+
+	/*
+	 * write the manifest to a temporary file and atomically replace the old one
+	 */
+	void save_manifest(){
+
+		string tmp = dir + "/MANIFEST.tmp";
+
+		{
+			ofstream out(tmp);
+
+			out << "alphabet " << int(sigma()) << endl;
+			out << "term " << int(TERM) << endl;
+			out << "base " << base << endl;
+			out << "fanout " << fanout << endl;
+			out << "generation " << generation << endl;
+
+			for(uint64_t i = 0; i < levels.size(); ++i)
+				if(levels[i].file.size() > 0) out << "level " << i << " " << levels[i].file << " " << levels[i].size << endl;
+
+			out.flush();
+
+			if(not out.good()){
+
+				cout << "Error: cannot write manifest of collection " << dir << endl;
+				exit(1);
+
+			}
+
+		}
+
+		sync_file(tmp);
+
+		if(rename(tmp.c_str(), (dir + "/MANIFEST").c_str()) != 0){
+
+			cout << "Error: cannot write manifest of collection " << dir << endl;
+			exit(1);
+
+		}
+
+		//make the rename durable
+		sync_file(dir);
+
+	}
+
+	/*
+	 * flush file (or directory) path to disk
+	 */
+	static void sync_file(string path){
+
+		int fd = open(path.c_str(), O_RDONLY);
+
+		if(fd < 0 or fsync(fd) != 0){
+
+			cout << "Error: cannot flush " << path << " to disk" << endl;
+			exit(1);
+
+		}
+
+		close(fd);
+
+	}
+
+	string dir;
+
+	char TERM = '#';
+
+	uint64_t base = 0;
+	uint64_t fanout = 0;
+	uint64_t generation = 0;
+
+};
+
+#endif /* INTERNAL_BWT_COLLECTION_HPP_ */
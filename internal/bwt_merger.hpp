@@ -20,6 +20,33 @@
  *
  *  If alphabet is {A,C,G,T,N,#} (dna_bwt_n used instead of dna_bwt) then space usage is increased by 0.05*n Bytes.
  *
+ * Optionally, the traversal state is periodically checkpointed (see checkpoint.hpp): DA and LCP are then stored in
+ * file-backed arrays, and an interrupted run can be resumed from its last checkpoint.
+ *
+ * Optionally, the LCP is a shared mapping of the output LCP file: it is not copied at the end, and the kernel can
+ * page it out under memory pressure.
+ *
+ * Optionally, only min(LCP, K) is computed: node pairs of depth >= K are not visited, and the positions left empty
+ * are set to K at the end. Since the DA needs all leaves, these are then all visited in the first pass (as if the
+ * input LCPs were reused), so that the nodes pass does not have to look for the leaves it skipped.
+ *
+ * If all leaves are visited in the first pass (the LCP is not computed, input LCPs are reused, or K is given), the
+ * DA is final before the nodes pass. If the output path is known in advance (merge_options::out_path), the merged
+ * BWT and the DA are then submitted to the output writer before the nodes pass, so that they are written while the
+ * nodes are navigated; save_to_file then only adds the LCP.
+ *
+ * LCP histogram (if the LCP is computed), node and leaf sizes are collected during the run and stored in the run
+ * statistics (see lcp_stats.hpp), except after a resume.
+ *
+ * Optionally, the nodes pass also reports the maximal repeats shared by the two collections (cross-sample comparison
+ * at merge cost): strings W with |W| >= L occurring in both collections that are right-maximal (followed by at least
+ * two distinct characters) and left-maximal (preceded by at least two distinct characters) in the union, each
+ * terminator being a distinct character (see repeats.hpp): the left-maximal node pairs, and the left-maximal terminal
+ * strings reached from them by Weiner links. If the LCP is not computed, only node pairs with both sides non-empty are
+ * visited. Output: a repeats file (see repeats.hpp) with records of 5 words: |W|, count1, count2, begin1, begin2.
+ * W occupies interval [begin1, begin1+count1) of BWT 1, [begin2, begin2+count2) of BWT 2 and [begin1+begin2,
+ * begin1+begin2+count1+count2) of the merged BWT.
+ *
  * Based on an extension (to BWTs of collections) of the suffix-tree navigation algorithm described in
  *
  * "Linear time construction of compressed text indices in compact space" by Djamal Belazzougui.
@@ -32,234 +59,727 @@
 #include "dna_bwt.hpp"
 #include "dna_bwt_n.hpp"
 #include "include.hpp"
+#include "output_writer.hpp"
+#include "compressed_lcp.hpp"
+#include "progress.hpp"
+#include "checkpoint.hpp"
+#include "mmap_array.hpp"
+#include "packed_da.hpp"
+#include "stats.hpp"
+#include "st_traversal.hpp"
+#include "repeats.hpp"
+#include "lcp_stats.hpp"
 #include <stack>
+#include <memory>
 #include <algorithm>
 
 using namespace std;
 
+#define REP_MERGE_RECORD_WORDS 5
+
+/*
+ * options of class bwt_merger
+ */
+struct merge_options{
+
+	//compute the LCP array of the merged BWT
+	bool compute_lcp = false;
+
+	//store the document array to file
+	bool out_da = false;
+
+	//if compute_lcp and both are given: LCP arrays of bwt1 and bwt2 (same integer width lcp_int_t). Inside runs of
+	//the DA the merged LCP is copied from them, so only the node pairs containing suffixes of both collections
+	//(i.e. those that can set the LCP where the DA switches collection) are navigated.
+	string lcp1_path = "";
+	string lcp2_path = "";
+
+	//if not empty, save a checkpoint every ckpt_seconds seconds in files ckpt_path.ckpt (traversal state),
+	//ckpt_path.ckpt.da and ckpt_path.ckpt.lcp (DA and LCP arrays)
+	string ckpt_path = "";
+	uint64_t ckpt_seconds = 0;
+
+	//resume from the checkpoint in ckpt_path (if any) instead of starting from scratch
+	bool resume = false;
+
+	//if not empty and compute_lcp, the LCP is built directly in this file (memory mapped), which is also used as
+	//checkpoint file for the LCP. save_to_file(base) does not write the LCP if lcp_path = base.lcp.
+	string lcp_path = "";
+
+	//if > 0 and compute_lcp, compute min(LCP, depth_cap) (depth_cap must be smaller than the largest value of lcp_int_t)
+	uint64_t depth_cap = 0;
+
+	//if not empty, stream to this file the shared maximal repeats of length >= min_repeat. Not compatible with
+	//checkpoints and depth_cap.
+	string repeats_path = "";
+	uint64_t min_repeat = 1;
+
+	//if not empty: the arguments save_to_file will be called with. If the DA is final after the leaves pass, BWT
+	//and DA start being written (with n_threads threads) before the nodes pass.
+	string out_path = "";
+	uint64_t n_threads = 0;
+	bool packed_bwt = false;
+	bool binary_da = false;
+
+};
+
 template<class bwt_t, typename lcp_int_t>
 class bwt_merger{
 
 public:
 
 	/*
-	 * merge bwt1 and bwt2. Parameters:
-	 *
-	 * bwt1, bwt2: the two BWTs.
-	 * compute_lcp = if true, compute the LCP array of the merged BWT.
-	 * out_da = store to file document array.
-	 *
+	 * merge bwt1 and bwt2, with the given options (see merge_options).
 	 */
-	bwt_merger(bwt_t * bwt1, bwt_t * bwt2, bool compute_lcp = false, bool out_da = false){
+	bwt_merger(bwt_t * bwt1, bwt_t * bwt2, merge_options opt = merge_options()){
 
-		this->out_da = out_da;
+		this->out_da = opt.out_da;
 		this->bwt1 = bwt1;
 		this->bwt2 = bwt2;
 
+		this->compute_lcp = opt.compute_lcp;
+		reuse_lcp = compute_lcp and opt.lcp1_path.size()>0 and opt.lcp2_path.size()>0;
+
+		assert(depth_cap < nil);
+
+		this->depth_cap = compute_lcp ? opt.depth_cap : 0;
+		K = this->depth_cap > 0 ? this->depth_cap : nil;
+
+		//all leaves are visited in the first pass
+		all_leaves = not compute_lcp or reuse_lcp or this->depth_cap > 0;
+
+		find_repeats = opt.repeats_path.size()>0;
+		this->min_repeat = opt.min_repeat;
+
+		if(find_repeats) TS = terminal_strings<bwt_t, 2>(bwt1, bwt2, min_repeat);
+
+		assert(not find_repeats or (opt.ckpt_path.size()==0 and this->depth_cap == 0));
+
 		n = bwt1->size() + bwt2->size();
 
-		DA = vector<bool>(n);
+		uint64_t phase = LEAVES;//phase to start from
+		vector<uint64_t> counters;//counters of the checkpoint
 
-		if(compute_lcp){
+		if(opt.ckpt_path.size()>0){
 
-			LCP = vector<lcp_int_t>(n, nil);
-			LCP[0] = 0;
-		}
+			ckpt = checkpoint(opt.ckpt_path + ".ckpt", opt.ckpt_seconds, {n, sizeof(lcp_int_t), compute_lcp, reuse_lcp, this->depth_cap, bwt1->checksum(), bwt2->checksum()});
+			da_file = opt.ckpt_path + ".ckpt.da";
+			lcp_file = opt.lcp_path.size()>0 ? opt.lcp_path : opt.ckpt_path + ".ckpt.lcp";
+
+			resumed = opt.resume and ckpt.load(phase, counters);
+
+			if(opt.resume and not resumed) cout << "No checkpoint found in " << opt.ckpt_path << ".ckpt: starting from scratch." << endl;
+
+			DA = bit_array(da_file, n, resumed);
+			if(compute_lcp) LCP = mmap_array<lcp_int_t>(lcp_file, n, nil, resumed);
+
+		}else if(compute_lcp and opt.lcp_path.size()>0){
+
+			DA = bit_array(n);
+
+			lcp_file = opt.lcp_path;
+			LCP = mmap_array<lcp_int_t>(lcp_file, n, nil, false);
 
-		/*
-		 * FIRST PASS: NAVIGATE LEAVES AND MERGE BWTs (i.e. build DA). If enabled, compute LCP inside leaves.
-		 */
+		}else{
 
-		cout << "\nNow navigating suffix tree leaves to compute Document Array";
-		if(compute_lcp) cout << " and compute internal LCP values";
-		cout << "." << endl;
+			DA = bit_array(n);
+			if(compute_lcp) LCP = mmap_array<lcp_int_t>(n, nil);
+
+		}
+
+		if(compute_lcp) LCP[0] = 0;
 
-		uint64_t da_values = 0;//number computed DA values
 		uint64_t leaves = 0;//number of visited leaves
 		uint64_t max_stack = 0;
-		uint64_t lcp_values = 1;//number of computed LCP values
 
-		{
+		if(resumed){
+
+			da_values = counters[2];
+
+			//the LCP may also contain values computed after the checkpoint
+			if(compute_lcp) lcp_values = n - std::count(LCP.data(), LCP.data()+n, nil);
+
+			cout << "Resuming from checkpoint: phase " << (phase == LEAVES ? "leaves" : "nodes") << ", " << da_values << "/" << n << " DA values";
+			if(compute_lcp) cout << " and " << lcp_values << "/" << n << " LCP values";
+			cout << " already computed." << endl;
+
+		}
+
+		//if input LCPs are reused (or only repeats are searched), node pairs with an empty side are not visited
+		auto T = st_traversal<pair_tree<bwt_t> >(pair_tree<bwt_t>(bwt1, bwt2, reuse_lcp or not compute_lcp));
 
-			auto TMP_LEAVES = vector<pair<sa_leaf, sa_leaf> >(5);
+		//after a resume from the nodes phase, leaves navigation and LCP copy have already been completed
+		if(phase == LEAVES){
+
+			/*
+			 * FIRST PASS: NAVIGATE LEAVES AND MERGE BWTs (i.e. build DA). If enabled, compute LCP inside leaves.
+			 * If input LCPs are reused, all leaves are visited (so DA is complete after this pass) and only the
+			 * LCP value where the leaf switches from collection 1 to collection 2 is computed.
+			 */
+
+			cout << "\nNow navigating suffix tree leaves to compute Document Array";
+			if(compute_lcp) cout << " and compute internal LCP values";
+			cout << "." << endl;
+
+			stats.begin_phase("leaves");
 
 			stack<pair<sa_leaf, sa_leaf> > S;
-			S.push({bwt1->first_leaf(), bwt2->first_leaf()});
 
-			int last_perc_lcp = -1;
-			int last_perc_da = -1;
-			int perc_lcp = 0;
-			int perc_da = 0;
+			if(resumed){
+
+				S = ckpt.get_stack<pair<sa_leaf, sa_leaf> >();
+				leaves = counters[0];
+				max_stack = counters[1];
+
+			}else{
 
-			while(not S.empty()){
+				S.push(T.first_leaf());
 
-				pair<sa_leaf, sa_leaf> L = S.top();
-				S.pop();
-				leaves++;
+			}
 
-				assert(leaf_size(L)>0);
-				max_stack = S.size() > max_stack ? S.size() : max_stack;
+			P.reset(new progress("leaves", n, compute_lcp ? vector<string>{"DA", "LCP"} : vector<string>{"DA"}, da_values, lcp_values));
 
-				sa_leaf L1 = L.first;
-				sa_leaf L2 = L.second;
+			//visit leaf iff size(L1) + size(L2) >= min_size
+			//optimization: if we are computing LCP and if size(L1) + size(L2) = 1,
+			//then we will find that leaf during the internal nodes traversal (no need to visit leaf here)
+			T.visit_leaves(*this, S, leaves, max_stack, all_leaves ? 1 : 2);
 
-				update_DA(L1,L2,compute_lcp,lcp_values,da_values);
+			P->stop();
 
-				//insert leaf in stack iff size(L1) + size(L2) >= min_size
-				//optimization: if we are computing LCP and if size(L1) + size(L2) = 1,
-				//then we will find that leaf during the internal nodes traversal (no need to visit leaf here)
-				int t = 0;//number of children leaves
-				next_leaves(bwt1, bwt2, L1, L2, TMP_LEAVES, t, compute_lcp ? 2 : 1);
-				for(int i=t-1;i>=0;--i) S.push(TMP_LEAVES[i]);
+			cout << "Computed " << da_values << "/" << n << " DA values." << endl;
 
-				perc_lcp = (100*lcp_values)/n;
-				perc_da = (100*da_values)/n;
+			if(compute_lcp)
+			cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
 
-				if(perc_da > last_perc_da){
+			cout << "Max stack depth = " << max_stack << endl;
+			cout << "Processed " << leaves << " suffix-tree leaves." << endl;
 
-					cout << "DA: " << perc_da << "%. ";
-					if(compute_lcp) cout << "LCP: " << perc_lcp << "%.";
-					cout << endl;
+			stats.end_phase(leaves, max_stack);
+			stats.print_counters(n, "leaf");
 
-					last_perc_lcp = perc_lcp;
-					last_perc_da = perc_da;
+			if(reuse_lcp){
 
-				}
+				cout << "\nCopying LCP values inside DA runs from " << opt.lcp1_path << " and " << opt.lcp2_path << "." << endl;
+
+				stats.begin_phase("copy_lcp");
+
+				copy_lcp(opt.lcp1_path, opt.lcp2_path, lcp_values);
+
+				stats.end_phase(n);
+
+				cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
 
 			}
+
 		}
 
-		cout << "Computed " << da_values << "/" << n << " DA values." << endl;
+		if(find_repeats) REP = repeat_writer(opt.repeats_path, min_repeat, REP_MERGE_RECORD_WORDS);
 
-		if(compute_lcp)
-		cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
+		//the DA is final: write BWT and DA while the nodes are navigated
+		if(all_leaves and opt.out_path.size()>0 and (compute_lcp or find_repeats)){
 
-		cout << "Max stack depth = " << max_stack << endl;
-		cout << "Processed " << leaves << " suffix-tree leaves." << endl;
+			cout << "\nWriting merged BWT and DA in the background." << endl;
 
-		if(compute_lcp){
+			out.reset(new output_writer(opt.n_threads));
+			out_path = opt.out_path;
+			out_bytes = submit_bwt_da(opt.out_path, opt.packed_bwt, opt.binary_da);
+
+		}
 
-			cout << "\nNow navigating suffix tree nodes to compute remaining LCP and DA values." << endl;
+		if(compute_lcp or find_repeats){
 
-			auto TMP_NODES = vector<pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> >(5);
+			if(compute_lcp) cout << "\nNow navigating suffix tree nodes to compute remaining LCP and DA values." << endl;
+			else cout << "\nNow navigating suffix tree nodes shared by the two collections." << endl;
+
+			stats.begin_phase("nodes");
 
 			uint64_t nodes = 0;//visited ST nodes
 			max_stack = 0;
 
 			stack<pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> > S;
-			S.push({bwt1->root(), bwt2->root()});
 
-			int last_perc_lcp = -1;
-			int perc_lcp = 0;
-			int last_perc_da = -1;
-			int perc_da = 0;
+			if(resumed and phase == NODES){
 
-			while(not S.empty()){
+				S = ckpt.get_stack<pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> >();
+				nodes = counters[0];
+				max_stack = counters[1];
 
-				max_stack = S.size() > max_stack ? S.size() : max_stack;
+			}else{
 
-				pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> N = S.top();
-				S.pop();
-				nodes++;
+				S.push(T.root());
 
-				typename bwt_t::sa_node_t N1 = N.first;
-				typename bwt_t::sa_node_t N2 = N.second;
-				typename bwt_t::sa_node_t merged = merge_nodes(N1, N2);
+				//the leaves (and the LCP copy) will not be repeated if the run is interrupted from now on
+				if(ckpt.enabled()) save_checkpoint(NODES, {nodes, max_stack, da_values}, S);
 
-				//find leaves in the children of N1 and N2 that were
-				//skipped in the first pass, and update DA accordingly
-				find_leaves(N1, N2, da_values);
+			}
+
+			if(compute_lcp) P.reset(new progress("nodes", n, {"LCP", "DA"}, lcp_values, da_values));
+			else P.reset(new progress("nodes", n, {"nodes"}));
+
+			T.visit_nodes(*this, S, nodes, max_stack);
+
+			P->stop();
+
+			if(compute_lcp){
+
+				cout << "Computed " << da_values << "/" << n << " DA values." << endl;
+				cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
+
+			}
+
+			cout << "Max stack depth = " << max_stack << endl;
+			cout << "Processed " << nodes << " suffix-tree nodes." << endl;
 
-				//compute LCP values at the borders of merged's children
-				update_lcp<lcp_int_t>(merged, LCP, lcp_values);
+			stats.end_phase(nodes, max_stack);
+			stats.print_counters(n, "node");
 
-				//follow Weiner links
-				int t = 0;
-				next_nodes(bwt1, bwt2, N1, N2, TMP_NODES, t);
-				for(int i=t-1;i>=0;--i) S.push(TMP_NODES[i]);
+			if(depth_cap > 0){
 
-				perc_lcp = (100*lcp_values)/n;
-				perc_da = (100*da_values)/n;
+				cout << "\nSetting the remaining " << n - lcp_values << " LCP values to " << depth_cap << "." << endl;
 
-				if(perc_da > last_perc_da){
+				H[NODES].add_lcp(depth_cap, n - lcp_values);
 
-					cout << "DA: " << perc_da << "%. ";
-					cout << "LCP: " << perc_lcp << "%.";
-					cout << endl;
+				for(uint64_t i=0;i<n;++i){
 
-					last_perc_lcp = perc_lcp;
-					last_perc_da = perc_da;
+					lcp_values += LCP[i]==nil;
+					LCP[i] = LCP[i]==nil ? depth_cap : LCP[i];
 
 				}
 
+				stats.set("depth_cap", depth_cap);
+
 			}
 
-			cout << "Computed " << da_values << "/" << n << " DA values." << endl;
-			cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
-			cout << "Max stack depth = " << max_stack << endl;
-			cout << "Processed " << nodes << " suffix-tree nodes." << endl;
+		}
+
+		if(find_repeats){
+
+			REP.close();
+
+			cout << "Found " << REP.size() << " shared maximal repeats of length >= " << min_repeat << " (stored to " << opt.repeats_path << ")." << endl;
+
+			stats.set("min_repeat", min_repeat);
+			stats.set("shared_repeats", REP.size());
+
+		}
+
+		//the counters of the phases before a checkpoint are lost
+		if(not resumed){
+
+			H[LEAVES].merge(H[NODES]);
+
+			if(compute_lcp){
+
+				H[LEAVES].add_lcp(0);//LCP[0]
+				cout << "Max LCP = " << H[LEAVES].max_lcp << ", max node depth = " << H[LEAVES].max_node_depth << endl;
+
+			}
+
+			H[LEAVES].save(stats, compute_lcp);
 
 		}
 
+		stats.set("n", n);
+		stats.set("da_values", da_values);
+		if(compute_lcp) stats.set("lcp_values", lcp_values);
+
+	}
+
+	/*
+	 * build the merged BWT directly as a packed, rank-ready index, block by block: each output block is filled by
+	 * copying the runs of DA (found 64 bits at a time) from the decoded blocks of the two input BWTs, then packed and
+	 * counted once. No ASCII parsing is involved.
+	 */
+	bwt_t merged_bwt(){
+
+		auto it1 = bwt1->get_reader(0);
+		auto it2 = bwt2->get_reader(0);
+
+		uint64_t i = 0;
+
+		return bwt_t(n, [&](char * buf, uint64_t len){
+
+			uint64_t end = i + len;
+
+			while(i < end){
+
+				uint64_t run = std::min(end, DA.run_end(i)) - i;
+
+				if(DA[i]==0) it1.read(buf, run);
+				else it2.read(buf, run);
+
+				buf += run;
+				i += run;
+
+			}
+
+		}, bwt1->terminator());
+
 	}
 
 	/*
 	 * store to file the components that have been built (BWT, DA for sure; optionally, LCP). Adds extensions .bwt, .da, .lcp
+	 *
+	 * Output is split in chunks that are formatted and written in parallel by n_threads threads (0 = number of hardware threads).
+	 * The three files are written concurrently.
+	 *
+	 * If packed_bwt is true, the BWT is stored as a packed index (extension .dbwt, see dna_bwt::save_to_file) instead
+	 * of an ASCII file: it can be given as input to bwt2lcp and merge_bwt without being parsed and re-indexed.
+	 *
+	 * If binary_da is true, the DA is stored as a bit vector with a rank directory (extension .bda, see packed_da.hpp)
+	 * instead of an ASCII file of 0/1.
+	 *
+	 * If compress_lcp is true, the LCP is stored in compressed form (extension .lcpz, see compressed_lcp.hpp).
 	 */
-	void save_to_file(string base_path){
+	void save_to_file(string base_path, uint64_t n_threads = 0, bool packed_bwt = false, bool binary_da = false, bool compress_lcp = false){
+
+		string lcp_path = base_path;
+		lcp_path.append(".lcp");
+
+		stats.begin_phase("save");
+
+		//BWT and DA may already be in the writer (submitted before the nodes pass)
+		bool submitted = out != nullptr;
+
+		assert(not submitted or base_path == out_path);
+
+		if(not submitted) out.reset(new output_writer(n_threads));
+
+		uint64_t bytes = LCP.size() * sizeof(lcp_int_t);
+
+		//the LCP does not need formatting: start writing it while the BWT is being decoded. Nothing
+		//to do if it has been built directly in the output file.
+		if(LCP.size()>0 and compress_lcp) bytes = compressed_lcp::save(LCP.data(), LCP.size(), base_path + ".lcpz", *out);
+		else if(LCP.size()>0 and lcp_path != lcp_file) out->write_raw(lcp_path, LCP.data(), LCP.size() * sizeof(lcp_int_t));
+
+		bytes += submitted ? out_bytes : submit_bwt_da(base_path, packed_bwt, binary_da);
+
+		out->wait();
+		out.reset();
+
+		if(packed_bwt) bytes += uint64_t(filesize(base_path + ".dbwt"));
+
+		stats.end_phase(n);
+		stats.set("bytes_written", bytes);
+		if(submitted) stats.set("bwt_da_before_nodes", true);
+		if(LCP.size()>0 and compress_lcp) stats.set("lcp_raw_bytes", LCP.size() * sizeof(lcp_int_t));
+
+		remove_checkpoint(lcp_path);
+
+	}
+
+	/*
+	 * traversal callbacks (see st_traversal.hpp)
+	 */
+
+	/*
+	 * merge the two sides of leaf L (DA) and fill the LCP inside it
+	 */
+	inline bool on_leaf(pair<sa_leaf, sa_leaf> & L){
+
+		assert(leaf_size(L)>0);
+
+		uint64_t filled = lcp_values;
+
+		update_DA(L.first,L.second,compute_lcp and not reuse_lcp,lcp_values,da_values);
+
+		H[LEAVES].add_leaf(leaf_size(L));
+		H[LEAVES].add_lcp(std::min(L.first.depth, K), lcp_values - filled);
+
+		return true;
+
+	}
+
+	/*
+	 * fill the LCP at the borders of the children of the merged node (and the DA of the leaves skipped in the first pass)
+	 */
+	inline bool on_node(pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> & N){
+
+		typename bwt_t::sa_node_t N1 = N.first;
+		typename bwt_t::sa_node_t N2 = N.second;
+		typename bwt_t::sa_node_t merged = merge_nodes(N1, N2);
+
+		//find leaves in the children of N1 and N2 that were
+		//skipped in the first pass, and update DA accordingly
+		if(not all_leaves) find_leaves(N1, N2, da_values);
+
+		//compute LCP values at the borders of merged's children. If input LCPs
+		//are reused, some of them have already been copied.
+		uint64_t filled = lcp_values;
+
+		if(compute_lcp) update_lcp<lcp_int_t>(merged, LCP, lcp_values, reuse_lcp or resumed);
+
+		H[NODES].add_lcp(N1.depth, lcp_values - filled);
+		H[NODES].add_node(node_size(merged), N1.depth);
+
+		if(find_repeats and node_size(N1) > 0 and node_size(N2) > 0) add_repeats(N1, N2);
+
+		//children have depth N1.depth+1: their LCP values are at least K
+		return N1.depth+1 < K;
+
+	}
+
+	void on_sample(uint64_t leaves, uint64_t max_stack, stack<pair<sa_leaf, sa_leaf> > & S){
+
+		P->update(leaves, S.size(), da_values, lcp_values);
+
+		if(ckpt.due()) save_checkpoint(LEAVES, {leaves, max_stack, da_values}, S);
+
+		LCP.flush_async();
+
+	}
+
+	void on_sample(uint64_t nodes, uint64_t max_stack, stack<pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> > & S){
+
+		if(compute_lcp) P->update(nodes, S.size(), lcp_values, da_values);
+		else P->update(nodes, S.size(), nodes);
+
+		if(ckpt.due()) save_checkpoint(NODES, {nodes, max_stack, da_values}, S);
+
+		LCP.flush_async();
+
+	}
+
+	run_stats stats;//time spent in each phase, counters
+
+private:
+
+	enum {LEAVES, NODES};//traversal phases
+
+	bit_array DA; //document array
+	mmap_array<lcp_int_t> LCP;
+
+	checkpoint ckpt;//disabled if no checkpoint path is given
+	string da_file;//file backing DA if checkpoints are enabled
+	string lcp_file;//file backing LCP (empty if the LCP is in anonymous memory)
+
+	bool resumed = false;//the run was resumed from a checkpoint
+
+	uint64_t depth_cap = 0;//if > 0, compute min(LCP, depth_cap)
+	uint64_t K = 0;//depth_cap, or nil if there is no cap
+
+	bool compute_lcp = false;
+	bool all_leaves = false;//all leaves are visited in the first pass (the nodes pass does not look for leaves)
+
+	uint64_t da_values = 0;//number computed DA values
+	uint64_t lcp_values = 1;//number of computed LCP values
+
+	unique_ptr<progress> P;//progress of the running phase
+
+	unique_ptr<output_writer> out;//writer of the output files, if BWT and DA are submitted before the nodes pass
+	string out_path;//base path of the output submitted before the nodes pass
+	uint64_t out_bytes = 0;//Bytes of the BWT and DA submitted before the nodes pass
+
+	lcp_stats H[2];//repeat structure, per phase
+
+	bool find_repeats = false;//stream the shared maximal repeats to REP
+	uint64_t min_repeat = 1;//minimum length of a reported repeat
+
+	repeat_writer REP;
+	terminal_strings<bwt_t, 2> TS;//shared maximal repeats followed only by terminators
+
+	/*
+	 * stream the node pair (N1, N2), if it is a maximal repeat, and the shared maximal terminal strings reached from it
+	 */
+	template<class node_t>
+	void add_repeats(node_t & N1, node_t & N2){
+
+		if(N1.depth >= min_repeat and left_maximal(N1, N2)){
+
+			uint64_t rec[REP_MERGE_RECORD_WORDS] = {N1.depth, node_size(N1), node_size(N2), N1.first_TERM, N2.first_TERM};
+			REP.add(rec);
+
+		}
+
+		range_t node[2] = {range_t(N1.first_TERM, N1.last), range_t(N2.first_TERM, N2.last)};
+		range_t term[2] = {child_TERM(N1), child_TERM(N2)};
+
+		TS.visit(node, term, N1.depth, [&](uint64_t depth, range_t * r){
+
+			uint64_t rec[REP_MERGE_RECORD_WORDS] = {depth, range_length(r[0]), range_length(r[1]), r[0].first, r[1].first};
+			REP.add(rec);
+
+		});
+
+	}
+
+	/*
+	 * true iff the occurrences of the merged node (N1, N2) are preceded by at least two distinct characters
+	 * (each terminator being distinct)
+	 */
+	bool left_maximal(sa_node & N1, sa_node & N2){
+
+		uint64_t c1[5], c2[5];
+
+		letter_counts(bwt1->LF(range_t(N1.first_TERM, N1.last)), node_size(N1), c1);
+		letter_counts(bwt2->LF(range_t(N2.first_TERM, N2.last)), node_size(N2), c2);
+
+		for(int i=0;i<5;++i) c1[i] += c2[i];
+
+		return ::left_maximal(c1, 5, node_size(N1) + node_size(N2));
+
+	}
+
+	bool left_maximal(sa_node_n & N1, sa_node_n & N2){
+
+		uint64_t c1[6], c2[6];
+
+		letter_counts(bwt1->LF(range_t(N1.first_TERM, N1.last)), node_size(N1), c1);
+		letter_counts(bwt2->LF(range_t(N2.first_TERM, N2.last)), node_size(N2), c2);
+
+		for(int i=0;i<6;++i) c1[i] += c2[i];
+
+		return ::left_maximal(c1, 6, node_size(N1) + node_size(N2));
+
+	}
+
+	/*
+	 * submit DA and merged BWT (see save_to_file) to the output writer. Returns the number of Bytes of the ASCII BWT
+	 * and of the DA (the size of the packed BWT is known only once it is written).
+	 */
+	uint64_t submit_bwt_da(string base_path, bool packed_bwt, bool binary_da){
 
 		string bwt_path = base_path;
 		bwt_path.append(".bwt");
 
 		string da_path = base_path;
-		da_path.append(".da");
+		da_path.append(binary_da ? ".bda" : ".da");
 
-		string lcp_path = base_path;
-		lcp_path.append(".lcp");
+		uint64_t bytes = 0;
 
-		{
-			std::ofstream out(bwt_path);
+		if(out_da and binary_da){
 
-			uint64_t rank1 = 0;
-			for(uint64_t i=0;i<n;++i){
+			bytes += packed_da::save(DA, da_path, *out);
 
-				char c = DA[i]==0 ? bwt1->operator[](i-rank1) : bwt2->operator[](rank1);
+		}else if(out_da){
 
-				out.write((char*)&c,sizeof(c));
+			out->write_formatted(da_path, n, 1, [this](uint64_t begin, uint64_t end, char * buf){
 
-				rank1 += DA[i];
+				for(uint64_t i=begin;i<end;++i) buf[i-begin] = DA[i] ? '1' : '0';
+
+			});
+
+			bytes += n;
 
-			}
-			out.close();
 		}
 
-		if(out_da){
-			std::ofstream out(da_path);
-			for(uint64_t i=0;i<n;++i){
+		if(packed_bwt){
 
-				uint8_t c = DA[i] ? '1' : '0';
-				out.write((char*)&c,sizeof(c));
+			//built by one writer thread while the DA (and LCP) are being written
+			string dbwt_path = base_path + ".dbwt";
+			out->submit([this, dbwt_path](){ merged_bwt().save_to_file(dbwt_path); });
+
+			return bytes;
 
-			}
-			out.close();
 		}
 
-		if(LCP.size()>0){
+		//rank1[c] = number of 1s in DA before the c-th chunk of the BWT. Chunks are counted in parallel.
+		uint64_t n_chunks = n/OUT_CHUNK_SIZE + (n%OUT_CHUNK_SIZE != 0);
+		auto rank1 = make_shared<vector<uint64_t> >(n_chunks+1,0);
+
+		{
+			output_writer count(out->number_of_threads());
+
+			for(uint64_t c=0;c<n_chunks;++c){
 
-			std::ofstream out(lcp_path);
+				count.submit([this, c, rank1](){
 
-			out.write((char*)LCP.data(),LCP.size() * sizeof(lcp_int_t));
+					uint64_t end = std::min<uint64_t>(n, (c+1)*OUT_CHUNK_SIZE);
+
+					(*rank1)[c+1] = DA.count_ones(c*OUT_CHUNK_SIZE, end);
+
+				});
+
+			}
 
-			out.close();
+			count.wait();
+
+			for(uint64_t c=0;c<n_chunks;++c) (*rank1)[c+1] += (*rank1)[c];
 
 		}
 
+		out->write_formatted(bwt_path, n, 1, [this, rank1](uint64_t begin, uint64_t end, char * buf){
+
+			assert(begin%OUT_CHUNK_SIZE == 0);
+
+			uint64_t r1 = (*rank1)[begin/OUT_CHUNK_SIZE];
+
+			auto it1 = bwt1->get_reader(begin-r1);
+			auto it2 = bwt2->get_reader(r1);
+
+			for(uint64_t i=begin;i<end;++i) buf[i-begin] = DA[i]==0 ? it1.next() : it2.next();
+
+		});
+
+		return bytes + n;
+
 	}
 
-private:
+	/*
+	 * flush DA and LCP to disk, then save the traversal state
+	 */
+	template<class T>
+	void save_checkpoint(uint64_t phase, vector<uint64_t> counters, stack<T> & S){
+
+		DA.sync();
+		LCP.sync();
+		ckpt.save(phase, counters, S);
+
+	}
+
+	/*
+	 * the run is complete: delete the checkpoint and the files backing DA and LCP (unless
+	 * the LCP is the output file lcp_path)
+	 */
+	void remove_checkpoint(string lcp_path){
+
+		if(not ckpt.enabled()) return;
 
-	vector<bool> DA; //document array
-	vector<lcp_int_t> LCP;
+		ckpt.remove();
+		std::remove(da_file.c_str());
+		if(lcp_file != lcp_path) std::remove(lcp_file.c_str());
+
+	}
+
+	/*
+	 * LCP[i] = LCP_c[j] at every position i such that DA[i-1] = DA[i] = c, where j is the rank of position i
+	 * among the suffixes of collection c: the two suffixes are adjacent also in collection c.
+	 * The two input LCPs are streamed sequentially.
+	 */
+	void copy_lcp(string lcp1_path, string lcp2_path, uint64_t & lcp_values){
+
+		if(uint64_t(filesize(lcp1_path)) != bwt1->size()*sizeof(lcp_int_t) or uint64_t(filesize(lcp2_path)) != bwt2->size()*sizeof(lcp_int_t)){
+
+			cout << "Error: the sizes of the input LCP files do not match the BWTs (or the chosen LCP width)." << endl;
+			exit(1);
+
+		}
+
+		ifstream in1(lcp1_path);
+		ifstream in2(lcp2_path);
+
+		for(uint64_t i=0;i<n;++i){
+
+			lcp_int_t x;
+
+			if(DA[i]==0) in1.read((char*)&x, sizeof(lcp_int_t));
+			else in2.read((char*)&x, sizeof(lcp_int_t));
+
+			if(i>0 and DA[i]==DA[i-1]){
+
+				//after a resume, the value may have been copied before the interruption
+				assert(LCP[i]==nil or resumed);
+
+				H[LEAVES].add_lcp(std::min<uint64_t>(x, K), LCP[i]==nil);
+
+				lcp_values += LCP[i]==nil;
+				LCP[i] = std::min<uint64_t>(x, K);
+
+			}
+
+		}
+
+	}
 
 	void update_DA(sa_leaf L1,sa_leaf L2, bool compute_lcp, uint64_t & lcp_values, uint64_t & m){
 
@@ -269,15 +789,10 @@ private:
 
 		assert(end>start1);
 
-		for(uint64_t i = start1; i<start2; ++i){
-			DA[i] = 0;
-			m++;
-		}
+		DA.set_range(start1, start2, 0);
+		DA.set_range(start2, end, 1);
 
-		for(uint64_t i = start2; i<end; ++i){
-			DA[i] = 1;
-			m++;
-		}
+		m += end - start1;
 
 		assert(L1.depth==L2.depth);
 
@@ -285,14 +800,23 @@ private:
 
 			for(uint64_t i = start1+1; i<end; ++i){
 
-				assert(LCP[i]==nil);
+				//after a resume, the value may have been computed after the checkpoint
+				assert(LCP[i]==nil or resumed);
 
-				LCP[i] = L1.depth;
+				lcp_values += LCP[i]==nil;
 
-				lcp_values++;
+				LCP[i] = std::min(L1.depth, K);
 
 			}
 
+		}else if(reuse_lcp and start2>start1 and end>start2){
+
+			//the only position inside the leaf where DA switches collection
+			assert(LCP[start2]==nil or resumed);
+
+			lcp_values += LCP[start2]==nil;
+			LCP[start2] = std::min(L1.depth, K);
+
 		}
 
 		assert(m<=n);
@@ -434,6 +958,7 @@ private:
 	uint64_t n = 0;//total size
 
 	bool out_da = false;
+	bool reuse_lcp = false;//copy LCP values inside DA runs from the input LCPs
 
 	bwt_t * bwt1 = NULL;
 	bwt_t * bwt2 = NULL;
@@ -443,102 +968,4 @@ private:
 };
 
 
-void next_leaves(dna_bwt_t * bwt1, dna_bwt_t * bwt2, sa_leaf & L1, sa_leaf & L2, vector<pair<sa_leaf, sa_leaf> > & TMP_LEAVES, int & t, int min_size){
-
-	p_range ext_1 = bwt1->LF(L1.rn);
-	p_range ext_2 = bwt2->LF(L2.rn);
-
-	//push non-empty leaves on stack in decreasing size order
-
-	t = 0;
-
-	if(range_length(ext_1.A) + range_length(ext_2.A) >= min_size) TMP_LEAVES[t++] = {{ext_1.A, L1.depth+1},{ext_2.A, L2.depth+1}};
-	if(range_length(ext_1.C) + range_length(ext_2.C) >= min_size) TMP_LEAVES[t++] = {{ext_1.C, L1.depth+1},{ext_2.C, L2.depth+1}};
-	if(range_length(ext_1.G) + range_length(ext_2.G) >= min_size) TMP_LEAVES[t++] = {{ext_1.G, L1.depth+1},{ext_2.G, L2.depth+1}};
-	if(range_length(ext_1.T) + range_length(ext_2.T) >= min_size) TMP_LEAVES[t++] = {{ext_1.T, L1.depth+1},{ext_2.T, L2.depth+1}};
-
-	std::sort( TMP_LEAVES.begin(), TMP_LEAVES.begin()+t, [ ]( const pair<sa_leaf, sa_leaf>& lhs, const pair<sa_leaf, sa_leaf>& rhs )
-	{
-		return leaf_size(lhs) < leaf_size(rhs);
-	});
-
-}
-
-void next_leaves(dna_bwt_n_t * bwt1, dna_bwt_n_t * bwt2, sa_leaf & L1, sa_leaf & L2, vector<pair<sa_leaf, sa_leaf> > & TMP_LEAVES, int & t, int min_size){
-
-	p_range_n ext_1 = bwt1->LF(L1.rn);
-	p_range_n ext_2 = bwt2->LF(L2.rn);
-
-	//push non-empty leaves on stack in decreasing size order
-
-	t = 0;
-
-	if(range_length(ext_1.A) + range_length(ext_2.A) >= min_size) TMP_LEAVES[t++] = {{ext_1.A, L1.depth+1},{ext_2.A, L2.depth+1}};
-	if(range_length(ext_1.C) + range_length(ext_2.C) >= min_size) TMP_LEAVES[t++] = {{ext_1.C, L1.depth+1},{ext_2.C, L2.depth+1}};
-	if(range_length(ext_1.G) + range_length(ext_2.G) >= min_size) TMP_LEAVES[t++] = {{ext_1.G, L1.depth+1},{ext_2.G, L2.depth+1}};
-	if(range_length(ext_1.N) + range_length(ext_2.N) >= min_size) TMP_LEAVES[t++] = {{ext_1.N, L1.depth+1},{ext_2.N, L2.depth+1}};
-	if(range_length(ext_1.T) + range_length(ext_2.T) >= min_size) TMP_LEAVES[t++] = {{ext_1.T, L1.depth+1},{ext_2.T, L2.depth+1}};
-
-	std::sort( TMP_LEAVES.begin(), TMP_LEAVES.begin()+t, [ ]( const pair<sa_leaf, sa_leaf>& lhs, const pair<sa_leaf, sa_leaf>& rhs )
-	{
-		return leaf_size(lhs) < leaf_size(rhs);
-	});
-
-}
-
-
-void next_nodes(dna_bwt_t * bwt1, dna_bwt_t * bwt2, sa_node & N1, sa_node & N2, vector<pair<sa_node, sa_node> > & TMP_NODES, int & t){
-
-	p_node left_exts1 = bwt1->LF(N1);
-	p_node left_exts2 = bwt2->LF(N2);
-
-	pair<sa_node, sa_node> A = {left_exts1.A, left_exts2.A};
-	pair<sa_node, sa_node> C = {left_exts1.C, left_exts2.C};
-	pair<sa_node, sa_node> G = {left_exts1.G, left_exts2.G};
-	pair<sa_node, sa_node> T = {left_exts1.T, left_exts2.T};
-
-	t = 0;
-
-	if(number_of_children(A) >= 2) TMP_NODES[t++] = A;
-	if(number_of_children(C) >= 2) TMP_NODES[t++] = C;
-	if(number_of_children(G) >= 2) TMP_NODES[t++] = G;
-	if(number_of_children(T) >= 2) TMP_NODES[t++] = T;
-
-	//push right-maximal nodes on stack in decreasing size (i.e. interval length) order
-
-	std::sort( TMP_NODES.begin(), TMP_NODES.begin()+t, [ ]( const pair<sa_node, sa_node>& lhs, const pair<sa_node, sa_node>& rhs )
-	{
-		return node_size(lhs) < node_size(rhs);
-	});
-
-}
-
-void next_nodes(dna_bwt_n_t * bwt1, dna_bwt_n_t * bwt2, sa_node_n & N1, sa_node_n & N2, vector<pair<sa_node_n, sa_node_n> > & TMP_NODES, int & t){
-
-	p_node_n left_exts1 = bwt1->LF(N1);
-	p_node_n left_exts2 = bwt2->LF(N2);
-
-	pair<sa_node_n, sa_node_n> A = {left_exts1.A, left_exts2.A};
-	pair<sa_node_n, sa_node_n> C = {left_exts1.C, left_exts2.C};
-	pair<sa_node_n, sa_node_n> G = {left_exts1.G, left_exts2.G};
-	pair<sa_node_n, sa_node_n> N = {left_exts1.N, left_exts2.N};
-	pair<sa_node_n, sa_node_n> T = {left_exts1.T, left_exts2.T};
-
-	t = 0;
-
-	if(number_of_children(A) >= 2) TMP_NODES[t++] = A;
-	if(number_of_children(C) >= 2) TMP_NODES[t++] = C;
-	if(number_of_children(G) >= 2) TMP_NODES[t++] = G;
-	if(number_of_children(N) >= 2) TMP_NODES[t++] = N;
-	if(number_of_children(T) >= 2) TMP_NODES[t++] = T;
-
-	//push right-maximal nodes on stack in decreasing size (i.e. interval length) order
-
-	std::sort( TMP_NODES.begin(), TMP_NODES.begin()+t, [ ]( const pair<sa_node_n, sa_node_n>& lhs, const pair<sa_node_n, sa_node_n>& rhs )
-	{
-		return node_size(lhs) < node_size(rhs);
-	});
-
-}
-
 #endif /* INTERNAL_BWT_MERGER_HPP_ */
@@ -0,0 +1,247 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * checkpoint.hpp
+ *
+ *  Created on: Jan 18, 2019
+ *      Author: nico
+ *
+ *  Checkpoints of a suffix tree traversal. The state of a traversal is small: the phase, a few counters and the
+ *  stack of leaves/nodes still to be visited. The (large) arrays being filled (LCP, DA) live in file-backed
+ *  mmap_arrays: the caller syncs them to disk, then calls save(), which writes the state to a temporary file
+ *  and atomically renames it to the checkpoint path.
+ *
+ *  Since the arrays keep being modified after a checkpoint, after a crash they may contain values computed after the
+ *  last checkpoint. These values are exact (every position receives always the same value), so a resumed traversal
+ *  simply skips positions that are already filled.
+ *
+ *  The header of the checkpoint (input checksums, sizes, options) must match the one of the resumed run.
+ *
+ */
+
+#ifndef INTERNAL_CHECKPOINT_HPP_
+#define INTERNAL_CHECKPOINT_HPP_
+
+#define CHECKPOINT_MAGIC "DCKP"
+#define CHECKPOINT_DEFAULT_SECONDS 1800 //checkpoint interval used if resuming without an explicit interval
+
+#include <string>
+#include <vector>
+#include <stack>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cassert>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+class checkpoint{
+
+public:
+
+	/*
+	 * checkpoints disabled
+	 */
+	checkpoint(){}
+
+	/*
+	 * path = checkpoint file, seconds = interval between checkpoints, header = values identifying the run
+	 * (checksums of the inputs, sizes, options)
+	 */
+	checkpoint(string path, uint64_t seconds, vector<uint64_t> header){
+
+		this->path = path;
+		this->seconds = seconds;
+		this->header = header;
+
+		next = chrono::steady_clock::now() + chrono::seconds(seconds);
+
+	}
+
+	bool enabled(){
+		return path.size() > 0;
+	}
+
+	/*
+	 * true if the interval since the last checkpoint has elapsed. Call it every few thousand iterations.
+	 */
+	inline bool due(){
+
+		return enabled() and chrono::steady_clock::now() >= next;
+
+	}
+
+	/*
+	 * store phase, counters and stack S (bottom to top). The arrays filled by the traversal must
+	 * already be synced to disk.
+	 */
+	template<class T>
+	void save(uint64_t phase, vector<uint64_t> counters, stack<T> S){
+
+		vector<T> entries;
+
+		while(not S.empty()){
+
+			entries.push_back(S.top());
+			S.pop();
+
+		}
+
+		std::reverse(entries.begin(), entries.end());
+
+		string tmp = path + ".tmp";
+
+		{
+
+			ofstream out(tmp, ios::binary);
+
+			uint64_t header_size = header.size();
+			uint64_t n_counters = counters.size();
+			uint64_t n_items = entries.size();
+			uint64_t item_size = sizeof(T);
+
+			out.write(CHECKPOINT_MAGIC, 4);
+			out.write((char*)&header_size, sizeof(header_size));
+			out.write((char*)header.data(), header_size*sizeof(uint64_t));
+			out.write((char*)&phase, sizeof(phase));
+			out.write((char*)&n_counters, sizeof(n_counters));
+			out.write((char*)counters.data(), n_counters*sizeof(uint64_t));
+			out.write((char*)&item_size, sizeof(item_size));
+			out.write((char*)&n_items, sizeof(n_items));
+			out.write((char*)entries.data(), n_items*sizeof(T));
+
+			out.close();
+
+			if(not out.good()){
+
+				cout << "Error: cannot write checkpoint " << tmp << endl;
+				exit(1);
+
+			}
+
+		}
+
+		//make sure the state is on disk before it replaces the previous one
+		int fd = open(tmp.c_str(), O_RDONLY);
+		fsync(fd);
+		close(fd);
+
+		if(rename(tmp.c_str(), path.c_str()) != 0){
+
+			cout << "Error: cannot rename " << tmp << " to " << path << endl;
+			exit(1);
+
+		}
+
+		next = chrono::steady_clock::now() + chrono::seconds(seconds);
+
+		cout << "Checkpoint saved (phase " << phase << ", " << entries.size() << " stack entries)." << endl;
+
+	}
+
+	/*
+	 * load phase and counters of the last checkpoint. Returns false if there is no checkpoint.
+	 * Exits with an error if the checkpoint does not belong to this run (different header).
+	 * The stack is then retrieved with get_stack.
+	 */
+	bool load(uint64_t & phase, vector<uint64_t> & counters){
+
+		ifstream in(path, ios::binary);
+
+		if(not in.good()) return false;
+
+		char magic[4] = {};
+		uint64_t header_size = 0;
+
+		in.read(magic, 4);
+		in.read((char*)&header_size, sizeof(header_size));
+
+		vector<uint64_t> h(in.good() and header_size == header.size() ? header_size : 0);
+		in.read((char*)h.data(), h.size()*sizeof(uint64_t));
+
+		if(not std::equal(magic, magic+4, CHECKPOINT_MAGIC) or not in.good() or h != header){
+
+			cout << "Error: checkpoint " << path << " was taken on different inputs or with different options." << endl;
+			exit(1);
+
+		}
+
+		uint64_t n_counters = 0;
+
+		in.read((char*)&phase, sizeof(phase));
+		in.read((char*)&n_counters, sizeof(n_counters));
+
+		counters = vector<uint64_t>(n_counters);
+		in.read((char*)counters.data(), n_counters*sizeof(uint64_t));
+
+		uint64_t n_items = 0;
+
+		in.read((char*)&item_size, sizeof(item_size));
+		in.read((char*)&n_items, sizeof(n_items));
+
+		items = vector<char>(n_items*item_size);
+		in.read(items.data(), items.size());
+
+		if(not in.good()){
+
+			cout << "Error: checkpoint " << path << " is truncated." << endl;
+			exit(1);
+
+		}
+
+		return true;
+
+	}
+
+	/*
+	 * stack stored in the loaded checkpoint
+	 */
+	template<class T>
+	stack<T> get_stack(){
+
+		assert(item_size == sizeof(T));
+
+		stack<T> S;
+
+		for(uint64_t i = 0; i < items.size(); i += sizeof(T)){
+
+			T x;
+			std::copy(items.data() + i, items.data() + i + sizeof(T), (char*)&x);
+			S.push(x);
+
+		}
+
+		return S;
+
+	}
+
+	/*
+	 * delete the checkpoint (the run is complete)
+	 */
+	void remove(){
+
+		if(enabled()) std::remove(path.c_str());
+
+	}
+
+private:
+
+	string path;
+	uint64_t seconds = 0;
+	vector<uint64_t> header;
+
+	chrono::steady_clock::time_point next;
+
+	//stack of the loaded checkpoint
+	uint64_t item_size = 0;
+	vector<char> items;
+
+};
+
+#endif /* INTERNAL_CHECKPOINT_HPP_ */
@@ -0,0 +1,486 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * compressed_lcp.hpp
+ *
+ *  Created on: Jan 22, 2019
+ *      Author: nico
+ *
+ *  Compressed LCP file (written by bwt2lcp/merge_bwt -z), with random access. The LCP is split in blocks of
+ *  LCPZ_BLOCK values; each block stores its minimum and the differences from the minimum, bit-packed with a width b
+ *  chosen per block (blocked frame of reference). Differences wider than b bits are patched (PFOR): their low b bits
+ *  stay in the packed array, their high bits are stored as exceptions after it. b minimizes the size of the block,
+ *  so a few outliers (e.g. the long LCPs of repeats) do not widen the whole block.
+ *
+ *  LCPZ_SUPERBLOCK consecutive blocks form a superblock: the file stores one absolute offset per superblock, and
+ *  each superblock starts with the 16-bit offsets of its blocks relative to it. Blocks are byte-aligned:
+ *
+ *  	header (64-bit little-endian words):
+ *  	[0]                       magic "DLCZ", then version (1 Byte), then W = Bytes per LCP value of the original array, then 2 Bytes = 0
+ *  	[1]                       n = number of LCP values
+ *  	[2]                       number of blocks b = ceil(n/LCPZ_BLOCK)
+ *  	[3]                       reserved (0)
+ *  	[4, 4+s)                  superblock directory: offset in Bytes (from the beginning of the file) of superblock
+ *  	                          i, i = 0, ..., s-1, s = ceil(b/LCPZ_SUPERBLOCK)
+ *
+ *  	superblock: LCPZ_SUPERBLOCK 16-bit offsets (in Bytes, from the beginning of the superblock) of its blocks, then
+ *  	the blocks. Block of len values:
+ *
+ *  	1 Byte                    b = bits per packed difference
+ *  	1 Byte                    e = number of exceptions
+ *  	1 Byte                    x = bits of the high part of the exceptions
+ *  	W Bytes                   minimum
+ *  	ceil(len*b/8) Bytes       low b bits of the differences
+ *  	e Bytes                   positions (in the block, increasing) of the exceptions
+ *  	ceil(e*x/8) Bytes         high parts (difference >> b) of the exceptions, x bits each
+ *
+ *  	The file ends with LCPZ_PADDING zero Bytes, so that bit fields can be read with unaligned 64-bit loads.
+ *
+ *  Consumers mmap the file (class compressed_lcp): lcp[i] reads two offsets and the block header, one packed value
+ *  and, if the block has exceptions, searches the position list; decode() decompresses a range block by block.
+ *
+ */
+
+#ifndef INTERNAL_COMPRESSED_LCP_HPP_
+#define INTERNAL_COMPRESSED_LCP_HPP_
+
+#define LCPZ_MAGIC "DLCZ"
+#define LCPZ_VERSION 2
+#define LCPZ_HEADER_WORDS 4
+#define LCPZ_BLOCK 128 //LCP values per block (at most 256: exception positions take 1 Byte)
+#define LCPZ_SUPERBLOCK 16 //blocks per superblock (a superblock takes less than 2^16 Bytes)
+#define LCPZ_PART_BLOCKS 8192 //blocks encoded by each task of the output writer (multiple of LCPZ_SUPERBLOCK)
+#define LCPZ_PADDING 16 //zero Bytes at the end of the file
+
+#include "output_writer.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+class compressed_lcp{
+
+public:
+
+	/*
+	 * asynchronously write LCP[0..n-1] to path in compressed form using writer out. The blocks are encoded by the
+	 * writer threads; LCP must stay valid until out.wait() returns. Returns the file size in Bytes.
+	 */
+	template<typename lcp_int_t>
+	static uint64_t save(lcp_int_t * LCP, uint64_t n, string path, output_writer & out){
+
+		const uint64_t W = sizeof(lcp_int_t);
+
+		uint64_t n_blocks = n/LCPZ_BLOCK + (n%LCPZ_BLOCK != 0);
+		uint64_t n_super = n_blocks/LCPZ_SUPERBLOCK + (n_blocks%LCPZ_SUPERBLOCK != 0);
+
+		//header and superblock directory: the sizes of all blocks are needed to compute the offsets
+		auto dir = make_shared<vector<uint64_t> >(LCPZ_HEADER_WORDS + n_super);
+		auto blocks = make_shared<vector<block_info> >(n_blocks);
+
+		char * magic = (char*)dir->data();
+		std::memcpy(magic, LCPZ_MAGIC, 4);
+		magic[4] = LCPZ_VERSION;
+		magic[5] = W;
+
+		(*dir)[1] = n;
+		(*dir)[2] = n_blocks;
+
+		vector<uint64_t> offsets = {0, dir->size()*sizeof(uint64_t)};//Bytes: header+directory, then one part per LCPZ_PART_BLOCKS blocks
+
+		uint64_t offset = offsets[1];//Bytes
+
+		for(uint64_t j=0;j<n_blocks;++j){
+
+			uint64_t begin = j*LCPZ_BLOCK;
+			uint64_t end = std::min(n, begin + LCPZ_BLOCK);
+
+			if(j%LCPZ_SUPERBLOCK == 0){
+
+				(*dir)[LCPZ_HEADER_WORDS + j/LCPZ_SUPERBLOCK] = offset;
+				offset += 2*LCPZ_SUPERBLOCK;
+
+			}
+
+			block_info & B = (*blocks)[j];
+
+			B.min = *std::min_element(LCP + begin, LCP + end);
+
+			//number of differences of each bit width
+			uint64_t H[65] = {0};
+			for(uint64_t i=begin;i<end;++i) H[bit_width(uint64_t(LCP[i]) - B.min)]++;
+
+			uint64_t w = 64;
+			while(w > 0 and H[w] == 0) w--;
+
+			//width of the packed differences minimizing the size of the block
+			uint64_t e = 0;
+			uint64_t best = block_bytes(end - begin, w, 0, 0, W);
+			B.b = w;
+
+			for(uint64_t b = w; b > 0; --b){
+
+				e += H[b];
+				uint64_t size = block_bytes(end - begin, b-1, e, w-(b-1), W);
+
+				if(size < best){
+
+					best = size;
+					B.b = b-1;
+					B.e = e;
+					B.x = w-(b-1);
+
+				}
+
+			}
+
+			offset += best;
+
+			if((j+1)%LCPZ_PART_BLOCKS == 0 or j+1 == n_blocks) offsets.push_back(offset);
+
+		}
+
+		offsets.back() += LCPZ_PADDING;
+
+		out.write_parts(path, offsets, [LCP, n, n_blocks, W, dir, blocks](uint64_t k, char * buf){
+
+			if(k == 0){
+
+				std::memcpy(buf, dir->data(), dir->size()*sizeof(uint64_t));
+				return;
+
+			}
+
+			uint64_t first = (k-1)*LCPZ_PART_BLOCKS;
+			uint64_t last = std::min(n_blocks, first + LCPZ_PART_BLOCKS);
+
+			//buf is zero-initialized: fields are written by OR-ing their bits
+			uint8_t * sb = (uint8_t*)buf;
+			uint64_t pos = 0;//Bytes from sb
+
+			for(uint64_t j=first;j<last;++j){
+
+				if(j%LCPZ_SUPERBLOCK == 0){
+
+					sb += pos;
+					pos = 2*LCPZ_SUPERBLOCK;
+
+				}
+
+				uint16_t rel = pos;
+				std::memcpy(sb + 2*(j%LCPZ_SUPERBLOCK), &rel, 2);
+
+				block_info & B = (*blocks)[j];
+
+				uint64_t begin = j*LCPZ_BLOCK;
+				uint64_t end = std::min(n, begin + LCPZ_BLOCK);
+
+				uint8_t * block = sb + pos;
+
+				block[0] = B.b;
+				block[1] = B.e;
+				block[2] = B.x;
+				std::memcpy(block + 3, &B.min, W);
+
+				uint8_t * packed = block + 3 + W;
+				uint8_t * exc = packed + bytes_of(B.b*(end - begin));
+				uint8_t * high = exc + B.e;
+
+				uint64_t t = 0;//exceptions found
+
+				for(uint64_t i=begin;i<end;++i){
+
+					uint64_t d = uint64_t(LCP[i]) - B.min;
+
+					put(packed, (i-begin)*B.b, B.b, d);
+
+					if(B.x > 0 and bit_width(d) > B.b){
+
+						exc[t] = i-begin;
+						put(high, t*B.x, B.x, d >> B.b);
+						t++;
+
+					}
+
+				}
+
+				assert(t == B.e);
+
+				pos += block_bytes(end - begin, B.b, B.e, B.x, W);
+
+			}
+
+		});
+
+		return offsets.back();
+
+	}
+
+	/*
+	 * map the compressed LCP stored in path (read-only)
+	 */
+	compressed_lcp(string path){
+
+		int fd = open(path.c_str(), O_RDONLY);
+
+		struct stat st;
+
+		if(fd < 0 or fstat(fd, &st) != 0 or uint64_t(st.st_size) < LCPZ_HEADER_WORDS*sizeof(uint64_t)){
+
+			cout << "Error: cannot open compressed LCP " << path << endl;
+			exit(1);
+
+		}
+
+		bytes = st.st_size;
+
+		void * p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if(p == MAP_FAILED){
+
+			cout << "Error: cannot map file " << path << endl;
+			exit(1);
+
+		}
+
+		file = (uint64_t*)p;
+
+		n = file[1];
+		n_blocks = file[2];
+		W = ((uint8_t*)file)[5];
+
+		super = file + LCPZ_HEADER_WORDS;
+
+		uint64_t n_super = n_blocks/LCPZ_SUPERBLOCK + (n_blocks%LCPZ_SUPERBLOCK != 0);
+
+		if(std::memcmp(file, LCPZ_MAGIC, 4) != 0 or ((char*)file)[4] != LCPZ_VERSION or W == 0 or W > 8 or
+			n_blocks != n/LCPZ_BLOCK + (n%LCPZ_BLOCK != 0) or bytes < (LCPZ_HEADER_WORDS + n_super)*sizeof(uint64_t) + LCPZ_PADDING){
+
+			cout << "Error: " << path << " is not a compressed LCP file" << endl;
+			exit(1);
+
+		}
+
+	}
+
+	compressed_lcp(const compressed_lcp &) = delete;
+	compressed_lcp & operator=(const compressed_lcp &) = delete;
+
+	~compressed_lcp(){
+
+		munmap(file, bytes);
+
+	}
+
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * Bytes per value of the original (uncompressed) LCP
+	 */
+	uint8_t width(){
+		return W;
+	}
+
+	inline uint64_t operator[](uint64_t i){
+
+		assert(i<n);
+
+		uint64_t j = i/LCPZ_BLOCK;
+		uint64_t k = i%LCPZ_BLOCK;
+
+		uint8_t * block = block_at(j);
+
+		uint64_t b = block[0];
+		uint64_t e = block[1];
+
+		uint8_t * packed = block + 3 + W;
+		uint64_t d = get(packed, k*b, b);
+
+		if(e > 0){
+
+			uint8_t * exc = packed + bytes_of(b*block_length(j));
+			uint8_t * t = std::lower_bound(exc, exc + e, k);
+
+			if(t != exc + e and *t == k) d |= get(exc + e, (t - exc)*block[2], block[2]) << b;
+
+		}
+
+		return block_min(block) + d;
+
+	}
+
+	/*
+	 * decode LCP[begin..end-1] into out (sequential access)
+	 */
+	template<typename T>
+	void decode(uint64_t begin, uint64_t end, T * out){
+
+		assert(begin <= end and end <= n);
+
+		while(begin < end){
+
+			uint64_t j = begin/LCPZ_BLOCK;
+			uint64_t first = j*LCPZ_BLOCK;
+			uint64_t last = std::min(end, first + LCPZ_BLOCK);
+
+			uint8_t * block = block_at(j);
+
+			uint64_t b = block[0];
+			uint64_t e = block[1];
+			uint64_t x = block[2];
+			uint64_t min = block_min(block);
+
+			uint8_t * packed = block + 3 + W;
+
+			for(uint64_t i = begin; i < last; ++i) out[i-begin] = min + get(packed, (i-first)*b, b);
+
+			//patch the exceptions in the range
+			uint8_t * exc = packed + bytes_of(b*block_length(j));
+
+			for(uint64_t t = 0; t < e; ++t){
+
+				uint64_t i = first + exc[t];
+
+				if(i >= begin and i < last) out[i-begin] = min + (get(packed, exc[t]*b, b) | (get(exc + e, t*x, x) << b));
+
+			}
+
+			out += last - begin;
+			begin = last;
+
+		}
+
+	}
+
+private:
+
+	struct block_info{
+
+		uint8_t b = 0;//bits per packed difference
+		uint8_t e = 0;//number of exceptions
+		uint8_t x = 0;//bits of the high part of the exceptions
+		uint64_t min = 0;
+
+	};
+
+	/*
+	 * number of bits needed to represent x
+	 */
+	static uint64_t bit_width(uint64_t x){
+
+		return x == 0 ? 0 : 64 - __builtin_clzll(x);
+
+	}
+
+	/*
+	 * Bytes needed to store the given number of bits
+	 */
+	static uint64_t bytes_of(uint64_t bits){
+
+		return bits/8 + (bits%8 != 0);
+
+	}
+
+	/*
+	 * Bytes used by a block of len values of W Bytes, packed with b bits, with e exceptions of x bits
+	 */
+	static uint64_t block_bytes(uint64_t len, uint64_t b, uint64_t e, uint64_t x, uint64_t W){
+
+		return 3 + W + bytes_of(len*b) + e + bytes_of(e*x);
+
+	}
+
+	/*
+	 * OR the w low bits of v at bit position pos of p
+	 */
+	static void put(uint8_t * p, uint64_t pos, uint64_t w, uint64_t v){
+
+		if(w < 64) v &= (uint64_t(1) << w) - 1;
+
+		while(w > 0){
+
+			uint64_t s = pos%8;
+			uint64_t l = std::min(w, 8 - s);
+
+			p[pos/8] |= uint8_t(v << s);
+
+			v >>= l;
+			pos += l;
+			w -= l;
+
+		}
+
+	}
+
+	/*
+	 * the w bits at bit position pos of p. Reads up to 9 Bytes from p + pos/8 (see LCPZ_PADDING).
+	 */
+	static inline uint64_t get(uint8_t * p, uint64_t pos, uint64_t w){
+
+		if(w == 0) return 0;
+
+		uint64_t x;
+		std::memcpy(&x, p + pos/8, 8);
+
+		x >>= pos%8;
+		if(pos%8 + w > 64) x |= uint64_t(p[pos/8 + 8]) << (64 - pos%8);
+
+		return w == 64 ? x : x & ((uint64_t(1) << w) - 1);
+
+	}
+
+	/*
+	 * block j: one superblock offset and one 16-bit offset inside the superblock
+	 */
+	inline uint8_t * block_at(uint64_t j){
+
+		uint8_t * sb = (uint8_t*)file + super[j/LCPZ_SUPERBLOCK];
+
+		uint16_t rel;
+		std::memcpy(&rel, sb + 2*(j%LCPZ_SUPERBLOCK), 2);
+
+		return sb + rel;
+
+	}
+
+	inline uint64_t block_min(uint8_t * block){
+
+		uint64_t min = 0;
+		std::memcpy(&min, block + 3, W);
+
+		return min;
+
+	}
+
+	inline uint64_t block_length(uint64_t j){
+
+		return std::min(uint64_t(LCPZ_BLOCK), n - j*LCPZ_BLOCK);
+
+	}
+
+	uint64_t * file = NULL;
+	uint64_t bytes = 0;
+
+	uint64_t n = 0;
+	uint64_t n_blocks = 0;
+	uint64_t W = 0;//Bytes per value of the original LCP
+
+	uint64_t * super = NULL;//superblock directory
+
+};
+
+#endif /* INTERNAL_COMPRESSED_LCP_HPP_ */
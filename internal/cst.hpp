@@ -0,0 +1,538 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * cst.hpp
+ *
+ *  Created on: Jan 24, 2019
+ *      Author: nico
+ *
+ *  Compressed suffix tree files (written by bwt2cst): the LCP array, the topology of the generalized suffix
+ *  tree in balanced parentheses and a range-minimum directory on the LCP (RMQ, PSV, NSV).
+ *
+ *  base.bps: DFS balanced parentheses of the tree (1 = '(', 0 = ')'). Internal nodes are the LCP intervals, leaves
+ *  are the n suffixes (a leaf is "()"), children are in lexicographic order. Same file format as the binary DA (see
+ *  packed_da.hpp), which provides rank/select on the parentheses. Length 2(n + number of internal nodes) <= 4n bits.
+ *
+ *  base.rmq: sequence of 64-bit little-endian words:
+ *
+ *  	[0]          magic "DCST", then version (1 Byte), then Bytes per LCP value, then 2 Bytes = 0
+ *  	[1]          n = number of LCP values
+ *  	[2]          h = number of levels of the directory
+ *  	[3]          number of internal nodes of the suffix tree
+ *  	[4, ...)     levels 1, ..., h: entry j of level k is the minimum of entries [j*CST_BLOCK, (j+1)*CST_BLOCK)
+ *  	             of level k-1, where level 0 is the LCP. Level k has ceil(n/CST_BLOCK^k) entries, level h has 1.
+ *
+ *  The directory takes about n/8 Bytes. Queries scan at most 2*CST_BLOCK entries per level.
+ *
+ */
+
+#ifndef INTERNAL_CST_HPP_
+#define INTERNAL_CST_HPP_
+
+#define CST_MAGIC "DCST"
+#define CST_VERSION 1
+#define CST_HEADER_WORDS 4
+#define CST_BLOCK 64 //entries per entry of the next directory level
+
+#include "mmap_array.hpp"
+#include "output_writer.hpp"
+#include "packed_da.hpp"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * sizes of the levels of the range-minimum directory of n LCP values (level 0 = the LCP)
+ */
+inline vector<uint64_t> cst_levels(uint64_t n){
+
+	vector<uint64_t> sizes = {n};
+
+	do{
+
+		sizes.push_back(sizes.back()/CST_BLOCK + (sizes.back()%CST_BLOCK != 0));
+
+	}while(sizes.back() > 1);
+
+	return sizes;
+
+}
+
+/*
+ * builds topology and directory from a complete LCP array
+ */
+template<typename lcp_int_t>
+class cst_builder{
+
+public:
+
+	/*
+	 * LCP[0..n-1] must not change until save() has been completed.
+	 *
+	 * The LCP intervals (internal nodes) opened before leaf i are found by a right-to-left scan (they are the intervals
+	 * whose left border is i) and kept in unary; those closed after leaf i by a left-to-right scan. Both scans use a
+	 * stack of strictly increasing depths, i.e. at most max(LCP)+1 words.
+	 */
+	cst_builder(lcp_int_t * LCP, uint64_t n) : LCP(LCP), n(n){
+
+		assert(n > 0);
+
+		//number of opening parentheses before leaf i: ones followed by a 0, written backwards from the end
+		bit_array open(2*n);
+		uint64_t p = open.size();
+
+		vector<uint64_t> S = {0};//the root
+
+		for(uint64_t i=n;i>0;--i){
+
+			uint64_t c = 0;
+
+			if(i > 1){
+
+				uint64_t l = LCP[i-1];
+
+				while(S.back() > l){
+
+					S.pop_back();
+					++c;
+
+				}
+
+				if(S.back() < l) S.push_back(l);
+
+			}else{
+
+				c = S.size();//intervals starting at 0, including the root
+
+			}
+
+			nodes += c;
+
+			--p;
+			open.set_range(p - c, p, 1);
+			p -= c;
+
+		}
+
+		BPS = bit_array(2*(n + nodes));
+		uint64_t pos = 0;
+
+		S = {0};
+
+		for(uint64_t i=0;i<n;++i){
+
+			uint64_t c = 0;
+			while(open[p++]) ++c;
+
+			BPS.set_range(pos, pos + c + 1, 1);//the intervals starting at i, then leaf i
+			pos += c + 2;
+
+			if(i+1 < n){
+
+				uint64_t l = LCP[i+1];
+
+				while(S.back() > l){
+
+					S.pop_back();
+					++pos;
+
+				}
+
+				if(S.back() < l) S.push_back(l);
+
+			}else{
+
+				pos += S.size();
+
+			}
+
+		}
+
+		assert(p == open.size());
+		assert(pos == BPS.size());
+
+		//range-minimum directory
+		vector<uint64_t> sizes = cst_levels(n);
+
+		RMQ = vector<uint64_t>(CST_HEADER_WORDS);
+
+		char * magic = (char*)RMQ.data();
+		std::memcpy(magic, CST_MAGIC, 4);
+		magic[4] = CST_VERSION;
+		magic[5] = sizeof(lcp_int_t);
+
+		RMQ[1] = n;
+		RMQ[2] = sizes.size() - 1;
+		RMQ[3] = nodes;
+
+		uint64_t prev = 0;//start of the previous level in RMQ
+
+		for(uint64_t k=1;k<sizes.size();++k){
+
+			uint64_t start = RMQ.size();
+
+			for(uint64_t j=0;j<sizes[k];++j){
+
+				uint64_t begin = j*CST_BLOCK;
+				uint64_t end = std::min(sizes[k-1], begin + CST_BLOCK);
+
+				uint64_t m = k == 1 ? *std::min_element(LCP + begin, LCP + end) : *std::min_element(RMQ.begin() + prev + begin, RMQ.begin() + prev + end);
+
+				RMQ.push_back(m);
+
+			}
+
+			prev = start;
+
+		}
+
+	}
+
+	/*
+	 * asynchronously write base.bps and base.rmq using writer out. This object must stay alive until out.wait()
+	 * returns. Returns the number of Bytes written.
+	 */
+	uint64_t save(string base, output_writer & out){
+
+		uint64_t bytes = packed_da::save(BPS, base + ".bps", out);
+
+		out.write_raw(base + ".rmq", RMQ.data(), RMQ.size()*sizeof(uint64_t));
+
+		return bytes + RMQ.size()*sizeof(uint64_t);
+
+	}
+
+	/*
+	 * number of internal nodes (LCP intervals, including the root)
+	 */
+	uint64_t number_of_nodes(){
+		return nodes;
+	}
+
+private:
+
+	lcp_int_t * LCP = NULL;
+	uint64_t n = 0;
+	uint64_t nodes = 0;
+
+	bit_array BPS;
+	vector<uint64_t> RMQ;
+
+};
+
+/*
+ * maps the files base.lcp, base.bps and base.rmq written by bwt2cst (read-only)
+ */
+template<typename lcp_int_t>
+class cst{
+
+public:
+
+	cst(string base) : BPS(base + ".bps"){
+
+		rmq_file = (uint64_t*)map(base + ".rmq", rmq_bytes);
+
+		if(rmq_bytes < CST_HEADER_WORDS*sizeof(uint64_t) or std::memcmp(rmq_file, CST_MAGIC, 4) != 0 or ((char*)rmq_file)[4] != CST_VERSION){
+
+			cout << "Error: " << base << ".rmq is not a range-minimum directory" << endl;
+			exit(1);
+
+		}
+
+		if(((char*)rmq_file)[5] != sizeof(lcp_int_t)){
+
+			cout << "Error: " << base << ".rmq was built for LCP values of " << int(((char*)rmq_file)[5]) << " Bytes" << endl;
+			exit(1);
+
+		}
+
+		n = rmq_file[1];
+		nodes = rmq_file[3];
+
+		sizes = cst_levels(n);
+		levels = vector<uint64_t*>(1);
+
+		uint64_t offset = CST_HEADER_WORDS;
+
+		for(uint64_t k=1;k<sizes.size();++k){
+
+			levels.push_back(rmq_file + offset);
+			offset += sizes[k];
+
+		}
+
+		LCP = (lcp_int_t*)map(base + ".lcp", lcp_bytes);
+
+		if(rmq_file[2] != sizes.size()-1 or rmq_bytes != offset*sizeof(uint64_t) or lcp_bytes != n*sizeof(lcp_int_t) or BPS.size() != 2*(n + nodes)){
+
+			cout << "Error: the files " << base << ".{lcp,bps,rmq} do not belong to the same suffix tree" << endl;
+			exit(1);
+
+		}
+
+	}
+
+	cst(const cst &) = delete;
+	cst & operator=(const cst &) = delete;
+
+	~cst(){
+
+		munmap(rmq_file, rmq_bytes);
+		munmap(LCP, lcp_bytes);
+
+	}
+
+	/*
+	 * number of leaves (suffixes)
+	 */
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * number of internal nodes, including the root
+	 */
+	uint64_t number_of_nodes(){
+		return nodes;
+	}
+
+	/*
+	 * the balanced parentheses, with rank/select
+	 */
+	packed_da & topology(){
+		return BPS;
+	}
+
+	inline uint64_t operator[](uint64_t i){
+
+		assert(i<n);
+		return LCP[i];
+
+	}
+
+	/*
+	 * leftmost position of the minimum of LCP[i..j]
+	 */
+	uint64_t rmq(uint64_t i, uint64_t j){
+
+		assert(i <= j and j < n);
+
+		return first_below(i, range_min(0, i, j+1) + 1);
+
+	}
+
+	/*
+	 * previous smaller value: largest j < i with LCP[j] < LCP[i], or n if there is none
+	 */
+	uint64_t psv(uint64_t i){
+
+		assert(i<n);
+
+		return i == 0 ? n : last_below(i-1, LCP[i]);
+
+	}
+
+	/*
+	 * next smaller value: smallest j > i with LCP[j] < LCP[i], or n if there is none
+	 */
+	uint64_t nsv(uint64_t i){
+
+		assert(i<n);
+
+		return i+1 == n ? n : first_below(i+1, LCP[i]);
+
+	}
+
+	/*
+	 * string depth of the internal node with leaves [l, r] (l < r)
+	 */
+	uint64_t depth(uint64_t l, uint64_t r){
+
+		assert(l < r and r < n);
+
+		return LCP[rmq(l+1, r)];
+
+	}
+
+	/*
+	 * leaves [l', r'] of the parent of the node (leaf if l = r) with leaves [l, r]. The root is its own parent.
+	 */
+	pair<uint64_t, uint64_t> parent(uint64_t l, uint64_t r){
+
+		assert(l <= r and r < n);
+
+		if(l == 0 and r == n-1) return {0, n-1};
+
+		//the deeper of the two borders is the depth of the parent
+		uint64_t k = l == 0 ? r+1 : (r+1 == n ? l : (LCP[l] >= LCP[r+1] ? l : r+1));
+		uint64_t v = LCP[k];
+
+		uint64_t begin = k == 0 ? n : last_below(k-1, v);
+		uint64_t end = k+1 == n ? n : first_below(k+1, v);
+
+		return {begin == n ? 0 : begin, end - 1};
+
+	}
+
+private:
+
+	static void * map(string path, uint64_t & bytes){
+
+		int fd = open(path.c_str(), O_RDONLY);
+
+		struct stat st;
+
+		if(fd < 0 or fstat(fd, &st) != 0 or st.st_size == 0){
+
+			cout << "Error: cannot open " << path << endl;
+			exit(1);
+
+		}
+
+		bytes = st.st_size;
+
+		void * p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if(p == MAP_FAILED){
+
+			cout << "Error: cannot map file " << path << endl;
+			exit(1);
+
+		}
+
+		return p;
+
+	}
+
+	/*
+	 * entry x of level k of the directory
+	 */
+	inline uint64_t get(uint64_t k, uint64_t x){
+
+		return k == 0 ? uint64_t(LCP[x]) : levels[k][x];
+
+	}
+
+	/*
+	 * minimum of entries [a, e) of level k
+	 */
+	uint64_t range_min(uint64_t k, uint64_t a, uint64_t e){
+
+		uint64_t m = ~uint64_t(0);
+
+		while(a < e and a%CST_BLOCK != 0) m = std::min(m, get(k, a++));
+		while(a < e and e%CST_BLOCK != 0) m = std::min(m, get(k, --e));
+
+		if(a < e) m = std::min(m, range_min(k+1, a/CST_BLOCK, e/CST_BLOCK));
+
+		return m;
+
+	}
+
+	/*
+	 * smallest j >= i with LCP[j] < v, or n: scan the rest of the block, then go up until a block
+	 * contains a smaller value and go down to its leftmost such entry
+	 */
+	uint64_t first_below(uint64_t i, uint64_t v){
+
+		uint64_t k = 0;
+		uint64_t x = i;
+
+		while(true){
+
+			uint64_t end = std::min(sizes[k], (x/CST_BLOCK + 1)*CST_BLOCK);
+
+			for(; x < end; ++x){
+
+				if(get(k, x) < v){
+
+					for(; k > 0; --k){
+
+						x *= CST_BLOCK;
+						while(get(k-1, x) >= v) ++x;
+
+					}
+
+					return x;
+
+				}
+
+			}
+
+			if(end == sizes[k]) return n;
+
+			x = end/CST_BLOCK;
+			++k;
+
+		}
+
+	}
+
+	/*
+	 * largest j <= i with LCP[j] < v, or n
+	 */
+	uint64_t last_below(uint64_t i, uint64_t v){
+
+		uint64_t k = 0;
+		uint64_t x = i;
+
+		while(true){
+
+			uint64_t begin = (x/CST_BLOCK)*CST_BLOCK;
+
+			for(;; --x){
+
+				if(get(k, x) < v){
+
+					for(; k > 0; --k){
+
+						x = std::min(sizes[k-1], (x+1)*CST_BLOCK) - 1;
+						while(get(k-1, x) >= v) --x;
+
+					}
+
+					return x;
+
+				}
+
+				if(x == begin) break;
+
+			}
+
+			if(begin == 0) return n;
+
+			x = begin/CST_BLOCK - 1;
+			++k;
+
+		}
+
+	}
+
+	packed_da BPS;
+
+	uint64_t * rmq_file = NULL;
+	uint64_t rmq_bytes = 0;
+
+	lcp_int_t * LCP = NULL;
+	uint64_t lcp_bytes = 0;
+
+	uint64_t n = 0;
+	uint64_t nodes = 0;
+
+	vector<uint64_t> sizes;//entries per level
+	vector<uint64_t*> levels;//levels[k] = level k of the directory (k >= 1)
+
+};
+
+#endif /* INTERNAL_CST_HPP_ */
@@ -0,0 +1,363 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * dbg.hpp
+ *
+ *  Created on: Jan 28, 2019
+ *      Author: nico
+ *
+ *  Order-k de Bruijn graph of a collection, straight from its (packed) BWT: nodes are the k-mers (over A,C,G,T)
+ *  occurring at least min_count times, and each (k+1)-mer occurring at least min_count times is an edge from its
+ *  prefix k-mer to its suffix k-mer (both occur at least as often as the edge).
+ *
+ *  The k-mers are navigated with kmer_traversal (kmer_counter.hpp). At node X, one more LF on the range of X gives
+ *  the number of occurrences of each aX: the incoming edges of X are found locally, without hashing.
+ *
+ *  Two output formats:
+ *
+ *  	plain   prefix.nodes: the nodes with their counts, and prefix.edges: the edges, as the (k+1)-mers aX with their
+ *  	        counts. Both are k-mer files (see kmer_counter.hpp, with k and k+1), in Weiner order, streamed.
+ *
+ *  	boss    prefix.boss: BOSS-style succinct graph. Nodes are sorted lexicographically (16 Bytes of RAM per node for
+ *  	        the sort) and each node lists the labels a of its incoming edges aX in increasing order ('$' if it has
+ *  	        none). This is the BOSS representation (Bowe et al., WABI 2012) of the graph of the reversed reads, in which
+ *  	        colexicographic order and outgoing edges become lexicographic order and incoming edges: the edge of node
+ *  	        X with label a leads to node aX[0..k-2].
+ *
+ *  	        As in BOSS, every node must be reached by one edge. A node Y without extensions Yb (of count >= min_count)
+ *  	        is reached through a chain of dummy nodes padded with '$' (smaller than A): $^k -> Y[k-1]$^(k-1) -> ... ->
+ *  	        Y[1..k-1]$ -> Y, with labels Y[k-1], ..., Y[0]. Dummy nodes are shared by the chains and sorted with the
+ *  	        other nodes. A header of 64-bit little-endian words
+ *
+ *  	        [0]          magic "DBOS", then version (1 Byte), then 3 Bytes = 0
+ *  	        [1]          k
+ *  	        [2]          number of nodes, including the dummy nodes
+ *  	        [3]          number of edges (labels, including '$')
+ *  	        [4..7]       number of nodes whose first symbol is A, C, G, T (the node $^k is the first node)
+ *  	        [8]          number of dummy nodes
+ *
+ *  	        is followed by one Byte per label, node by node: bits 0-2 = label ($=0, A=1, C=2, G=3, T=4), bit 3 = 1 if
+ *  	        the edge has the same target as the edge with the same label of a previous node (the nodes share the first
+ *  	        k-1 symbols), bit 4 = 1 on the last label of a node. The j-th label c without bit 3 is the edge reaching
+ *  	        the j-th node whose first symbol is c.
+ *
+ */
+
+#ifndef INTERNAL_DBG_HPP_
+#define INTERNAL_DBG_HPP_
+
+#define DBG_MAGIC "DBOS"
+#define DBG_VERSION 2
+#define DBG_HEADER_WORDS 9
+#define DBG_MAX_K (KMC_MAX_K-1) //edges are (k+1)-mers
+
+#include "kmer_counter.hpp"
+
+using namespace std;
+
+template<class bwt_t>
+class dbg_builder{
+
+public:
+
+	/*
+	 * build the de Bruijn graph of order k (1 <= k <= DBG_MAX_K) of bwt with nodes and edges occurring at least
+	 * min_count >= 1 times, and store it with prefix base (plain or BOSS format). n_threads = 0: number of hardware threads.
+	 */
+	dbg_builder(bwt_t * bwt, uint64_t k, uint64_t min_count, bool boss, string base, uint64_t n_threads = 0){
+
+		assert(k > 0 and k <= DBG_MAX_K);
+
+		this->k = k;
+		this->min_count = min_count;
+
+		if(n_threads == 0) n_threads = std::max<uint64_t>(1, thread::hardware_concurrency());
+
+		ofstream nodes_out;
+		ofstream edges_out;
+
+		if(not boss){
+
+			nodes_out = open(base + ".nodes");
+			edges_out = open(base + ".edges");
+
+			write_kmer_header(nodes_out, k, 0);
+			write_kmer_header(edges_out, k+1, 0);
+
+		}
+
+		cout << "\nNavigating the " << k << "-mers occurring at least " << min_count << " times." << endl;
+
+		stats.begin_phase("dbg");
+
+		progress P("dbg", bwt->size(), {"suffixes"});
+
+		kmer_traversal<bwt_t> T(bwt, k, min_count);
+
+		vector<pair<uint64_t, uint64_t> > sorted;//(node, (k << 8) | mask of incoming labels), if the output is BOSS
+		vector<pair<uint64_t, uint64_t> > node_buf, edge_buf;
+
+		T.template run<dbg_node>(n_threads, P, [&](kmer_range & X, vector<dbg_node> & buf, uint64_t){
+
+			buf.push_back({X.kmer, range_length(X.rn), {0,0,0,0}});
+			in_edges(bwt->LF(X.rn), buf.back());
+
+		}, [&](vector<dbg_node> & buf){
+
+			for(auto & x : buf){
+
+				uint64_t mask = 0;
+
+				for(uint64_t a = 0; a < 4; ++a){
+
+					if(x.in[a] < min_count) continue;
+
+					mask |= uint64_t(1) << a;
+					if(not boss) edge_buf.push_back({(a << (2*k)) | x.kmer, x.in[a]});
+
+				}
+
+				nodes++;
+				edges += __builtin_popcountll(mask);
+
+				if(boss) sorted.push_back({x.kmer, (k << 8) | mask});
+				else node_buf.push_back({x.kmer, x.count});
+
+			}
+
+			if(boss) return;
+
+			nodes_out.write((char*)node_buf.data(), node_buf.size()*sizeof(node_buf[0]));
+			edges_out.write((char*)edge_buf.data(), edge_buf.size()*sizeof(edge_buf[0]));
+
+			node_buf.clear();
+			edge_buf.clear();
+
+		});
+
+		P.stop();
+
+		if(boss){
+
+			save_boss(sorted, base + ".boss");
+
+		}else{
+
+			nodes_out.seekp(0);
+			write_kmer_header(nodes_out, k, nodes);
+			nodes_out.close();
+
+			edges_out.seekp(0);
+			write_kmer_header(edges_out, k+1, edges);
+			edges_out.close();
+
+			bytes = (2*KMC_HEADER_WORDS + 2*nodes + 2*edges)*sizeof(uint64_t);
+
+		}
+
+		cout << "Visited " << T.visited() << " ranges. Found " << nodes << " nodes and " << edges << " edges." << endl;
+
+		stats.end_phase(T.visited());
+
+		stats.set("k", k);
+		stats.set("min_count", min_count);
+		stats.set("nodes", nodes);
+		stats.set("edges", edges);
+		stats.set("bytes_written", bytes);
+
+	}
+
+	run_stats stats;//time spent in each phase, counters
+
+private:
+
+	//a node X, its count and the counts of the (k+1)-mers aX
+	struct dbg_node{
+
+		uint64_t kmer;
+		uint64_t count;
+		uint64_t in[4];
+
+	};
+
+	void in_edges(p_range e, dbg_node & x){
+
+		x.in[0] = range_length(e.A);
+		x.in[1] = range_length(e.C);
+		x.in[2] = range_length(e.G);
+		x.in[3] = range_length(e.T);
+
+	}
+
+	//edges aX with a = N are not in the graph
+	void in_edges(p_range_n e, dbg_node & x){
+
+		x.in[0] = range_length(e.A);
+		x.in[1] = range_length(e.C);
+		x.in[2] = range_length(e.G);
+		x.in[3] = range_length(e.T);
+
+	}
+
+	/*
+	 * sort the nodes, add the dummy nodes and write their incoming labels. A node is a pair (Z padded with A's to
+	 * k bases, (|Z| << 8) | mask of labels); |Z| < k for the dummy node Z$^(k-|Z|). With '$' < A, sorting the pairs
+	 * sorts the nodes lexicographically.
+	 */
+	void save_boss(vector<pair<uint64_t, uint64_t> > & sorted, string path){
+
+		cout << "Sorting " << sorted.size() << " nodes and storing the BOSS representation ... " << endl;
+
+		std::sort(sorted.begin(), sorted.end());
+
+		uint64_t dummies = add_dummy_nodes(sorted);
+
+		cout << "Added " << dummies << " dummy nodes." << endl;
+
+		ofstream out = open(path);
+
+		uint64_t header[DBG_HEADER_WORDS] = {0, k, sorted.size(), 0, 0, 0, 0, 0, dummies};
+
+		for(auto & x : sorted) if((x.second >> 8) > 0) header[4 + (x.first >> (2*(k-1)))]++;
+
+		vector<uint8_t> labels;
+
+		pair<uint64_t, uint64_t> prefix = {~uint64_t(0), 0};//first k-1 symbols of the current group of nodes
+		uint64_t seen = 0;//labels seen in the group
+
+		for(auto & x : sorted){
+
+			uint64_t len = x.second >> 8;
+			uint64_t mask = x.second & 0xF;
+
+			if(make_pair(x.first >> 2, std::min(len, k-1)) != prefix){
+
+				prefix = {x.first >> 2, std::min(len, k-1)};
+				seen = 0;
+
+			}
+
+			if(mask == 0){
+
+				labels.push_back(uint8_t(1) << 4);
+				continue;
+
+			}
+
+			for(uint64_t a = 0; a < 4; ++a){
+
+				if(((mask >> a) & 1) == 0) continue;
+
+				bool minus = (seen >> a) & 1;
+				bool last = (mask >> (a+1)) == 0;
+
+				labels.push_back(uint8_t(a+1) | (uint8_t(minus) << 3) | (uint8_t(last) << 4));
+
+			}
+
+			seen |= mask;
+
+		}
+
+		//'$' labels are edges of the BOSS representation
+		edges_boss = labels.size();
+		header[3] = edges_boss;
+
+		char * magic = (char*)header;
+		std::memcpy(magic, DBG_MAGIC, 4);
+		magic[4] = DBG_VERSION;
+
+		out.write((char*)header, sizeof(header));
+		out.write((char*)labels.data(), labels.size());
+		out.close();
+
+		bytes = sizeof(header) + labels.size();
+
+		stats.set("boss_labels", edges_boss);
+		stats.set("boss_dummy_nodes", dummies);
+
+	}
+
+	/*
+	 * add to the sorted nodes the chains of dummy nodes reaching the nodes Y without extensions Yb, and sort again.
+	 * The chains are built one level at a time (Y[1..k-1]$, then Y[2..k-1]$$, ...), merging the shared dummy nodes.
+	 * Returns the number of dummy nodes.
+	 */
+	uint64_t add_dummy_nodes(vector<pair<uint64_t, uint64_t> > & sorted){
+
+		uint64_t all = (uint64_t(1) << (2*k)) - 1;//k < 32
+
+		vector<pair<uint64_t, uint64_t> > level;//(Z padded with A's, mask) of the dummy nodes of the current level
+
+		for(auto & x : sorted){
+
+			uint64_t first = x.first >> (2*(k-1));
+
+			//the nodes Y[1..k-1]b are contiguous: Y is reached iff one of them has label Y[0]
+			auto it = std::lower_bound(sorted.begin(), sorted.end(), make_pair((x.first << 2) & all, uint64_t(0)));
+			uint64_t in = 0;
+
+			for(; it != sorted.end() and (it->first >> 2) == (x.first & (all >> 2)); ++it) in |= it->second;
+
+			if(((in >> first) & 1) == 0) level.push_back({(x.first << 2) & all, uint64_t(1) << first});
+
+		}
+
+		uint64_t n_real = sorted.size();
+
+		for(uint64_t len = k-1; level.size() > 0; --len){
+
+			std::sort(level.begin(), level.end());
+
+			vector<pair<uint64_t, uint64_t> > next;
+
+			for(uint64_t i = 0; i < level.size(); ++i){
+
+				uint64_t mask = level[i].second;
+
+				for(; i+1 < level.size() and level[i+1].first == level[i].first; ++i) mask |= level[i+1].second;
+
+				sorted.push_back({level[i].first, (len << 8) | mask});
+
+				if(len > 0) next.push_back({(level[i].first << 2) & all, uint64_t(1) << (level[i].first >> (2*(k-1)))});
+
+			}
+
+			level.swap(next);
+
+		}
+
+		std::sort(sorted.begin(), sorted.end());
+
+		return sorted.size() - n_real;
+
+	}
+
+	static ofstream open(string path){
+
+		ofstream out(path, ios::binary);
+
+		if(not out.good()){
+
+			cout << "Error: cannot open output file " << path << endl;
+			exit(1);
+
+		}
+
+		return out;
+
+	}
+
+	uint64_t k = 0;
+	uint64_t min_count = 1;
+
+	uint64_t nodes = 0;
+	uint64_t edges = 0;
+	uint64_t edges_boss = 0;//labels in the BOSS representation
+	uint64_t bytes = 0;//written Bytes
+
+};
+
+#endif /* INTERNAL_DBG_HPP_ */
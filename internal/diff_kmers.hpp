@@ -0,0 +1,150 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * diff_kmers.hpp
+ *
+ *  Created on: Jan 27, 2019
+ *      Author: nico
+ *
+ *  Differential k-mer analysis of two collections (e.g. tumour and normal reads) from their eBWTs, without merging them:
+ *  all k-mers (over A,C,G,T) whose number of occurrences c1 in collection 1 and c2 in collection 2 satisfy
+ *  min1 <= c1 <= max1 and min2 <= c2 <= max2.
+ *
+ *  The k-mers are enumerated by left extensions (Weiner links) from the empty string, navigating pairs of BWT ranges
+ *  (one per collection) down to depth k: the range of cW in BWT i is the c-range of LF applied to the range of W, and
+ *  its length is the number of occurrences of cW in collection i. Since counts can only decrease with extensions,
+ *  strings with c1 < min1 or c2 < min2 are not extended. The characters are taken from the extensions, so each k-mer
+ *  is spelled by its Weiner-link path. The pairs of ranges are navigated in parallel by kmer_traversal (see
+ *  kmer_counter.hpp), whose output keeps the Weiner order.
+ *
+ *  Output file: a header of 64-bit little-endian words
+ *
+ *  	[0]          magic "DKMR", then version (1 Byte), then 3 Bytes = 0
+ *  	[1]          k
+ *  	[2]          number of k-mers
+ *
+ *  followed by one record of 3 words per k-mer, in colexicographic order (i.e. sorted by reversed k-mer): the k-mer
+ *  (2 bits per base, A=0 C=1 G=2 T=3, first base in the most significant position), c1, c2.
+ *
+ */
+
+#ifndef INTERNAL_DIFF_KMERS_HPP_
+#define INTERNAL_DIFF_KMERS_HPP_
+
+#define KMR_MAGIC "DKMR"
+#define KMR_VERSION 1
+#define KMR_HEADER_WORDS 3
+#define KMR_RECORD_WORDS 3
+#define KMR_MAX_K 32
+
+#include "include.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+#include "kmer_counter.hpp"
+#include <fstream>
+#include <cstring>
+
+using namespace std;
+
+/*
+ * bounds on the number of occurrences of a k-mer in each collection
+ */
+struct kmer_filter{
+
+	uint64_t min1 = 1;
+	uint64_t max1 = ~uint64_t(0);
+	uint64_t min2 = 0;
+	uint64_t max2 = 0;
+
+};
+
+template<class bwt_t>
+class diff_kmers{
+
+public:
+
+	/*
+	 * stream to file path the k-mers (1 <= k <= KMR_MAX_K) of bwt1 and bwt2 passing filter f.
+	 * n_threads = 0: number of hardware threads.
+	 */
+	diff_kmers(bwt_t * bwt1, bwt_t * bwt2, uint64_t k, kmer_filter f, string path, uint64_t n_threads = 0){
+
+		assert(k > 0 and k <= KMR_MAX_K);
+
+		if(n_threads == 0) n_threads = std::max<uint64_t>(1, thread::hardware_concurrency());
+
+		uint64_t n = bwt1->size() + bwt2->size();
+
+		ofstream out(path, ios::binary);
+
+		if(not out.good()){
+
+			cout << "Error: cannot open output file " << path << endl;
+			exit(1);
+
+		}
+
+		uint64_t header[KMR_HEADER_WORDS] = {0, k, 0};
+
+		memcpy(header, KMR_MAGIC, 4);
+		header[0] |= uint64_t(KMR_VERSION) << 32;
+
+		out.write((char*)header, sizeof(header));
+
+		cout << "\nNavigating the " << k << "-mers of the two collections." << endl;
+
+		stats.begin_phase("kmers");
+
+		progress P("kmers", n, {"suffixes"});
+
+		kmer_traversal<bwt_t, kmer_range_pair> T(bwt1, bwt2, k, f.min1, f.min2);
+
+		T.template run<record_t>(n_threads, P, [&](kmer_range_pair & W, vector<record_t> & buf, uint64_t){
+
+			uint64_t c1 = range_length(W.r1);
+			uint64_t c2 = range_length(W.r2);
+
+			if(c1 <= f.max1 and c2 <= f.max2) buf.push_back({W.kmer, c1, c2});
+
+		}, [&](vector<record_t> & buf){
+
+			out.write((char*)buf.data(), buf.size()*sizeof(record_t));
+			kmers += buf.size();
+
+		});
+
+		P.stop();
+
+		out.seekp(2*sizeof(uint64_t));
+		out.write((char*)&kmers, sizeof(uint64_t));
+		out.close();
+
+		cout << "Visited " << T.visited() << " ranges. Found " << kmers << " " << k << "-mers (stored to " << path << ")." << endl;
+
+		stats.end_phase(T.visited());
+
+		stats.set("k", k);
+		stats.set("kmers", kmers);
+		stats.set("bytes_written", (KMR_HEADER_WORDS + kmers*KMR_RECORD_WORDS)*sizeof(uint64_t));
+
+	}
+
+	run_stats stats;//time spent in each phase, counters
+
+private:
+
+	struct record_t{
+
+		uint64_t kmer;
+		uint64_t c1;
+		uint64_t c2;
+
+	};
+
+	uint64_t kmers = 0;//number of reported k-mers
+
+};
+
+#endif /* INTERNAL_DIFF_KMERS_HPP_ */
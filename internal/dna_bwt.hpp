@@ -31,10 +31,18 @@ public:
 	dna_bwt(){};
 
 	/*
-	 * constructor path of a BWT file containing the BWT in ASCII format
+	 * constructor path of a BWT file containing the BWT in ASCII format, or of a packed index
+	 * written by save_to_file (in this case, TERM is read from the index).
 	 */
 	dna_bwt(string path, char TERM = '#'){
 
+		if(is_index(path)){
+
+			load_from_file(path);
+			return;
+
+		}
+
 		this->TERM = TERM;
 
 		n = uint64_t(filesize(path));
@@ -44,14 +52,18 @@ public:
 		uint64_t n_term = 0;
 
 		//build F column
+		auto it = get_reader(0);
+
 		for(uint64_t i=0;i<n;++i){
 
-			assert(BWT[i] < 256);
+			char c = it.next();
+
+			assert(c == BWT[i]);
 
-			F_A += (BWT[i]==TERM);
-			F_C += (BWT[i]=='A');
-			F_G += (BWT[i]=='C');
-			F_T += (BWT[i]=='G');
+			F_A += (c==TERM);
+			F_C += (c=='A');
+			F_G += (c=='C');
+			F_T += (c=='G');
 
 		}
 
@@ -61,6 +73,27 @@ public:
 
 	}
 
+	/*
+	 * constructor from a block source (see str_type): fill(buf, len) stores the next len BWT characters in buf.
+	 * The F column is obtained from the rank directory (no scan).
+	 */
+	template<class block_source>
+	dna_bwt(uint64_t n, block_source fill, char TERM = '#'){
+
+		this->TERM = TERM;
+		this->n = n;
+
+		BWT = str_type(n, fill, TERM);
+
+		p_rank r = BWT.parallel_rank(n);
+
+		F_A = n - (r.A + r.C + r.G + r.T);
+		F_C = F_A + r.A;
+		F_G = F_C + r.C;
+		F_T = F_G + r.G;
+
+	}
+
 	/*
 	 * get full BWT range
 	 */
@@ -110,6 +143,25 @@ public:
 
 	}
 
+	/*
+	 * sequential reader of the BWT starting from position i (decodes one block at a time)
+	 */
+	typename str_type::reader get_reader(uint64_t i){
+
+		return typename str_type::reader(&BWT, i);
+
+	}
+
+	/*
+	 * call f(i) for every run head i > 0 of the BWT (BWT[i] != BWT[i-1]), in increasing order
+	 */
+	template<class F>
+	void for_each_run_head(F f){
+
+		BWT.for_each_run_head(f);
+
+	}
+
 	/*
 	 * number of c before position i excluded
 	 */
@@ -137,17 +189,33 @@ public:
 
 	}
 
+	char terminator(){
+		return TERM;
+	}
+
+	/*
+	 * hash of the BWT content
+	 */
+	uint64_t checksum(){
+		return BWT.checksum();
+	}
+
 	uint64_t serialize(std::ostream& out){
 
 		uint64_t w_bytes = 0;
 
+		uint8_t sigma = 5;
+
+		out.write(INDEX_MAGIC,4);
+		out.write((char*)&sigma,sizeof(sigma));
+		out.write((char*)&TERM,sizeof(TERM));
 		out.write((char*)&n,sizeof(n));
 		out.write((char*)&F_A,sizeof(uint64_t));
 		out.write((char*)&F_C,sizeof(uint64_t));
 		out.write((char*)&F_G,sizeof(uint64_t));
 		out.write((char*)&F_T,sizeof(uint64_t));
 
-		w_bytes += sizeof(n) + sizeof(uint64_t)*4;
+		w_bytes += 4 + sizeof(sigma) + sizeof(TERM) + sizeof(n) + sizeof(uint64_t)*4;
 
 		w_bytes += BWT.serialize(out);
 
@@ -160,12 +228,26 @@ public:
 	 */
 	void load(std::istream& in) {
 
+		char magic[4] = {};
+		uint8_t sigma = 0;
+
+		in.read(magic,4);
+		in.read((char*)&sigma,sizeof(sigma));
+
+		if(not std::equal(magic, magic+4, INDEX_MAGIC) or sigma != 5){
+
+			cout << "Error: input is not a packed BWT index on alphabet of size 5" << endl;
+			exit(1);
+
+		}
+
+		in.read((char*)&TERM,sizeof(TERM));
 		in.read((char*)&n,sizeof(n));
 
-		in.read((char*)F_A,sizeof(uint64_t));
-		in.read((char*)F_C,sizeof(uint64_t));
-		in.read((char*)F_G,sizeof(uint64_t));
-		in.read((char*)F_T,sizeof(uint64_t));
+		in.read((char*)&F_A,sizeof(uint64_t));
+		in.read((char*)&F_C,sizeof(uint64_t));
+		in.read((char*)&F_G,sizeof(uint64_t));
+		in.read((char*)&F_T,sizeof(uint64_t));
 
 		BWT.load(in);
 
@@ -14,6 +14,7 @@
 
 #include "include.hpp"
 #include "dna_string_n.hpp"
+#include "dna_bwt.hpp"
 
 #ifndef INTERNAL_DNA_BWT_N_HPP_
 #define INTERNAL_DNA_BWT_N_HPP_
@@ -28,10 +29,18 @@ public:
 	dna_bwt_n(){};
 
 	/*
-	 * constructor path of a BWT file containing the BWT in ASCII format
+	 * constructor path of a BWT file containing the BWT in ASCII format, or of a packed index
+	 * written by save_to_file (in this case, TERM is read from the index).
 	 */
 	dna_bwt_n(string path, char TERM = '#'){
 
+		if(is_index(path)){
+
+			load_from_file(path);
+			return;
+
+		}
+
 		this->TERM = TERM;
 
 		n = uint64_t(filesize(path));
@@ -41,15 +50,19 @@ public:
 		uint64_t n_term = 0;
 
 		//build F column
+		auto it = get_reader(0);
+
 		for(uint64_t i=0;i<n;++i){
 
-			assert(BWT[i] < 256);
+			char c = it.next();
+
+			assert(c == BWT[i]);
 
-			F_A += (BWT[i]==TERM);
-			F_C += (BWT[i]=='A');
-			F_G += (BWT[i]=='C');
-			F_N += (BWT[i]=='G');
-			F_T += (BWT[i]=='N');
+			F_A += (c==TERM);
+			F_C += (c=='A');
+			F_G += (c=='C');
+			F_N += (c=='G');
+			F_T += (c=='N');
 
 		}
 
@@ -60,6 +73,28 @@ public:
 
 	}
 
+	/*
+	 * constructor from a block source (see str_type): fill(buf, len) stores the next len BWT characters in buf.
+	 * The F column is obtained from the rank directory (no scan).
+	 */
+	template<class block_source>
+	dna_bwt_n(uint64_t n, block_source fill, char TERM = '#'){
+
+		this->TERM = TERM;
+		this->n = n;
+
+		BWT = str_type(n, fill, TERM);
+
+		p_rank_n r = BWT.parallel_rank(n);
+
+		F_A = n - (r.A + r.C + r.G + r.N + r.T);
+		F_C = F_A + r.A;
+		F_G = F_C + r.C;
+		F_N = F_G + r.G;
+		F_T = F_N + r.N;
+
+	}
+
 	/*
 	 * get full BWT range
 	 */
@@ -110,6 +145,25 @@ public:
 
 	}
 
+	/*
+	 * sequential reader of the BWT starting from position i (decodes one block at a time)
+	 */
+	typename str_type::reader get_reader(uint64_t i){
+
+		return typename str_type::reader(&BWT, i);
+
+	}
+
+	/*
+	 * call f(i) for every run head i > 0 of the BWT (BWT[i] != BWT[i-1]), in increasing order
+	 */
+	template<class F>
+	void for_each_run_head(F f){
+
+		BWT.for_each_run_head(f);
+
+	}
+
 	/*
 	 * number of c before position i excluded
 	 */
@@ -137,10 +191,26 @@ public:
 
 	}
 
+	char terminator(){
+		return TERM;
+	}
+
+	/*
+	 * hash of the BWT content
+	 */
+	uint64_t checksum(){
+		return BWT.checksum();
+	}
+
 	uint64_t serialize(std::ostream& out){
 
 		uint64_t w_bytes = 0;
 
+		uint8_t sigma = 6;
+
+		out.write(INDEX_MAGIC,4);
+		out.write((char*)&sigma,sizeof(sigma));
+		out.write((char*)&TERM,sizeof(TERM));
 		out.write((char*)&n,sizeof(n));
 		out.write((char*)&F_A,sizeof(uint64_t));
 		out.write((char*)&F_C,sizeof(uint64_t));
@@ -148,7 +218,7 @@ public:
 		out.write((char*)&F_N,sizeof(uint64_t));
 		out.write((char*)&F_T,sizeof(uint64_t));
 
-		w_bytes += sizeof(n) + sizeof(uint64_t)*5;
+		w_bytes += 4 + sizeof(sigma) + sizeof(TERM) + sizeof(n) + sizeof(uint64_t)*5;
 
 		w_bytes += BWT.serialize(out);
 
@@ -161,12 +231,27 @@ public:
 	 */
 	void load(std::istream& in) {
 
+		char magic[4] = {};
+		uint8_t sigma = 0;
+
+		in.read(magic,4);
+		in.read((char*)&sigma,sizeof(sigma));
+
+		if(not std::equal(magic, magic+4, INDEX_MAGIC) or sigma != 6){
+
+			cout << "Error: input is not a packed BWT index on alphabet of size 6" << endl;
+			exit(1);
+
+		}
+
+		in.read((char*)&TERM,sizeof(TERM));
 		in.read((char*)&n,sizeof(n));
-		in.read((char*)F_A,sizeof(uint64_t));
-		in.read((char*)F_C,sizeof(uint64_t));
-		in.read((char*)F_G,sizeof(uint64_t));
-		in.read((char*)F_N,sizeof(uint64_t));
-		in.read((char*)F_T,sizeof(uint64_t));
+
+		in.read((char*)&F_A,sizeof(uint64_t));
+		in.read((char*)&F_C,sizeof(uint64_t));
+		in.read((char*)&F_G,sizeof(uint64_t));
+		in.read((char*)&F_N,sizeof(uint64_t));
+		in.read((char*)&F_T,sizeof(uint64_t));
 
 		BWT.load(in);
 
@@ -181,10 +266,26 @@ public:
 	}
 
 	/*
-	 * path = path of an index file
+	 * path = path of an index file. An index on {A,C,G,T,TERM} (dna_bwt) is widened to {A,C,G,N,T,TERM}, so that it
+	 * can be merged with a BWT containing N.
 	 */
 	void load_from_file(string path){
 
+		if(index_sigma(path) == 5){
+
+			cout << "Widening packed index " << path << " to alphabet A,C,G,N,T ... " << endl;
+
+			dna_bwt_t B;
+			B.load_from_file(path);
+
+			auto it = B.get_reader(0);
+
+			*this = dna_bwt_n(B.size(), [&](char * buf, uint64_t len){ it.read(buf, len); }, B.terminator());
+
+			return;
+
+		}
+
 		std::ifstream in(path);
 		load(in);
 		in.close();
@@ -55,22 +55,7 @@ public:
 
 		this->TERM = TERM;
 
-		n = uint64_t(filesize(path));
-
-		n_superblocks = (n+1)/SUPERBLOCK_SIZE + ((n+1)%SUPERBLOCK_SIZE != 0);
-		n_blocks = (n+1)/BLOCK_SIZE + ((n+1)%BLOCK_SIZE != 0);
-		nbytes = (n_blocks * BYTES_PER_BLOCK);//number of bytes effectively filled with data
-
-		superblock_ranks = vector<p_rank>(n_superblocks);
-
-		/*
-		 * this block of code ensures that data is aligned by 64 bytes = 512 bits
-		 */
-		memory = vector<uint8_t>(nbytes+ALN,0);
-		data = memory.data();
-		while(uint64_t(data) % ALN != 0) data++;
-
-		//cout << "alignment of data: " << (void*)data << endl;
+		allocate(uint64_t(filesize(path)));
 
 		{
 
@@ -117,6 +102,35 @@ public:
 
 	}
 
+	/*
+	 * constructor from a block source: fill(buf, len) is called once per block, in order, and must store the next
+	 * len <= BLOCK_SIZE characters of the string in buf[0..len-1]. Characters must be valid (no check is performed).
+	 */
+	template<class block_source>
+	dna_string(uint64_t n, block_source fill, char TERM = '#'){
+
+		this->TERM = TERM;
+
+		allocate(n);
+
+		string BUF(BLOCK_SIZE,'A');
+
+		for(uint64_t bl = 0; bl*BLOCK_SIZE < n; ++bl){
+
+			uint64_t len = std::min<uint64_t>(BLOCK_SIZE, n - bl*BLOCK_SIZE);
+
+			//the tail of the last block is padded with 'A'
+			if(len < BLOCK_SIZE) std::fill(BUF.begin() + len, BUF.end(), 'A');
+
+			fill(&BUF[0], len);
+			set(bl, BUF);
+
+		}
+
+		build_rank_support();
+
+	}
+
 	/*
 	 * set the i-th character to c.
 	 *
@@ -173,6 +187,148 @@ public:
 
 	}
 
+	/*
+	 * decode the i-th block to ASCII: stores its BLOCK_SIZE characters in out[0..BLOCK_SIZE-1].
+	 * Positions past the end of the string are decoded as 'A'.
+	 */
+	void decode_block(uint64_t i, char * out){
+
+		assert(i<n_blocks);
+
+		uint64_t superblock_number = i / BLOCKS_PER_SUPERBLOCK;
+		uint64_t block_number = i % BLOCKS_PER_SUPERBLOCK;
+
+		//code -> ASCII
+		const char lut[16] = {'A','C','G','T',TERM};
+
+		decode_planes(data + superblock_number*BYTES_PER_SUPERBLOCK + block_number*BYTES_PER_BLOCK, lut, out);
+
+		//the tail of the last block is not cleared when the string is built
+		uint64_t begin = i*BLOCK_SIZE;
+		if(begin + BLOCK_SIZE > n) std::fill(out + (n > begin ? n - begin : 0), out + BLOCK_SIZE, 'A');
+
+	}
+
+	/*
+	 * call f(i) for every run head i > 0 (character i differs from character i-1), in increasing order. Adjacent
+	 * characters are compared BLOCK_SIZE at a time: character k of a block is bit 127-k of each plane, so
+	 * plane ^ (plane >> 1) has bit 127-k set if characters k-1 and k differ in that plane.
+	 */
+	template<class F>
+	void for_each_run_head(F f){
+
+		uint64_t last = 0;//code of the last character of the previous block
+
+		for(uint64_t bl = 0; bl < n_blocks and bl*BLOCK_SIZE < n; ++bl){
+
+			uint64_t superblock_number = bl / BLOCKS_PER_SUPERBLOCK;
+			uint64_t block_number = bl % BLOCKS_PER_SUPERBLOCK;
+
+			__uint128_t* chars = (__uint128_t*)(data + superblock_number*BYTES_PER_SUPERBLOCK + block_number*BYTES_PER_BLOCK);
+
+			__uint128_t D = (chars[0] ^ (chars[0] >> 1)) | (chars[1] ^ (chars[1] >> 1)) | (chars[2] ^ (chars[2] >> 1));
+
+			//character 0 is compared with the last character of the previous block
+			uint64_t first = uint64_t(chars[0] >> 127) | (uint64_t(chars[1] >> 127) << 1) | (uint64_t(chars[2] >> 127) << 2);
+
+			__uint128_t top = __uint128_t(1) << 127;
+			D = bl > 0 and first != last ? D | top : D & ~top;
+
+			//only characters 0..len-1 of the block
+			uint64_t len = std::min(uint64_t(BLOCK_SIZE), n - bl*BLOCK_SIZE);
+			D &= ~((__uint128_t(1) << (128 - len)) - 1);
+
+			while(D != 0){
+
+				uint64_t hi = uint64_t(D >> 64);
+				uint64_t k = hi != 0 ? __builtin_clzll(hi) : 64 + __builtin_clzll(uint64_t(D));
+
+				f(bl*BLOCK_SIZE + k);
+
+				D &= ~(__uint128_t(1) << (127 - k));
+
+			}
+
+			uint64_t b = 128 - BLOCK_SIZE;//bit of the last character
+
+			last = uint64_t((chars[0] >> b) & 1) | (uint64_t((chars[1] >> b) & 1) << 1) | (uint64_t((chars[2] >> b) & 1) << 2);
+
+		}
+
+	}
+
+	/*
+	 * sequential access to the string starting from a given position: decodes one block at a time.
+	 */
+	class reader{
+
+	public:
+
+		reader(dna_string * s, uint64_t i = 0){
+
+			this->s = s;
+			block = i / BLOCK_SIZE;
+			off = i % BLOCK_SIZE;
+
+			if(block < s->n_blocks) s->decode_block(block, buf);
+
+		}
+
+		//return current character and move to the next one
+		inline char next(){
+
+			assert(block < s->n_blocks);
+
+			char c = buf[off++];
+
+			if(off == BLOCK_SIZE){
+
+				off = 0;
+				if(++block < s->n_blocks) s->decode_block(block, buf);
+
+			}
+
+			return c;
+
+		}
+
+		//copy the next len characters to out and move past them
+		inline void read(char * out, uint64_t len){
+
+			while(len > 0){
+
+				assert(block < s->n_blocks);
+
+				uint64_t l = std::min(len, uint64_t(BLOCK_SIZE) - off);
+
+				memcpy(out, buf + off, l);
+
+				out += l;
+				len -= l;
+				off += l;
+
+				if(off == BLOCK_SIZE){
+
+					off = 0;
+					if(++block < s->n_blocks) s->decode_block(block, buf);
+
+				}
+
+			}
+
+		}
+
+	private:
+
+		dna_string * s = NULL;
+
+		uint64_t block = 0;
+		uint64_t off = 0;
+
+		char buf[BLOCK_SIZE];
+
+	};
+
 	/*
 	 * Parallel rank of (A,C,T,G) at position i.
 	 */
@@ -232,8 +388,9 @@ public:
 		out.write((char*)&nbytes,sizeof(nbytes));
 		out.write((char*)&n_superblocks,sizeof(n_superblocks));
 		out.write((char*)&n_blocks,sizeof(n_blocks));
+		out.write((char*)&TERM,sizeof(TERM));
 
-		w_bytes += sizeof(n) + sizeof(nbytes) + sizeof(n_superblocks) + sizeof(n_blocks);
+		w_bytes += sizeof(n) + sizeof(nbytes) + sizeof(n_superblocks) + sizeof(n_blocks) + sizeof(TERM);
 
 		out.write((char*)superblock_ranks.data(),n_superblocks*sizeof(p_rank));
 		w_bytes += n_superblocks*sizeof(p_rank);
@@ -251,6 +408,7 @@ public:
 		in.read((char*)&nbytes,sizeof(nbytes));
 		in.read((char*)&n_superblocks,sizeof(n_superblocks));
 		in.read((char*)&n_blocks,sizeof(n_blocks));
+		in.read((char*)&TERM,sizeof(TERM));
 
 		superblock_ranks = vector<p_rank>(n_superblocks);
 		in.read((char*)superblock_ranks.data(),n_superblocks*sizeof(p_rank));
@@ -268,8 +426,51 @@ public:
 		return n;
 	}
 
+	/*
+	 * 64-bit hash of the content (characters and counters), e.g. to check that a checkpoint was taken on the same string
+	 */
+	uint64_t checksum(){
+
+		uint64_t h = 0xcbf29ce484222325ULL ^ n;
+		uint64_t * words = (uint64_t*)data;
+
+		for(uint64_t i=0;i<nbytes/8;++i){
+
+			h = (h ^ words[i]) * 0x100000001b3ULL;
+			h ^= h >> 32;
+
+		}
+
+		return h;
+
+	}
+
 private:
 
+	/*
+	 * allocate memory for a string of length n. Data is filled with 0s.
+	 */
+	void allocate(uint64_t n){
+
+		this->n = n;
+
+		n_superblocks = (n+1)/SUPERBLOCK_SIZE + ((n+1)%SUPERBLOCK_SIZE != 0);
+		n_blocks = (n+1)/BLOCK_SIZE + ((n+1)%BLOCK_SIZE != 0);
+		nbytes = (n_blocks * BYTES_PER_BLOCK);//number of bytes effectively filled with data
+
+		superblock_ranks = vector<p_rank>(n_superblocks);
+
+		/*
+		 * this block of code ensures that data is aligned by 64 bytes = 512 bits
+		 */
+		memory = vector<uint8_t>(nbytes+ALN,0);
+		data = memory.data();
+		while(uint64_t(data) % ALN != 0) data++;
+
+		//cout << "alignment of data: " << (void*)data << endl;
+
+	}
+
 	void build_rank_support(){
 
 		p_rank superblock_r = {};
@@ -53,22 +53,7 @@ public:
 
 		this->TERM = TERM;
 
-		n = uint64_t(filesize(path));
-
-		n_superblocks = (n+1)/SUPERBLOCK_SIZE_N_N + ((n+1)%SUPERBLOCK_SIZE_N_N != 0);
-		n_blocks = (n+1)/BLOCK_SIZE_N + ((n+1)%BLOCK_SIZE_N != 0);
-		nbytes = (n_blocks * BYTES_PER_BLOCK_N);//number of bytes effectively filled with data
-
-		superblock_ranks = vector<p_rank_n>(n_superblocks);
-
-		/*
-		 * this block of code ensures that data is aligned by 64 bytes = 512 bits
-		 */
-		memory = vector<uint8_t>(nbytes+ALN_N,0);
-		data = memory.data();
-		while(uint64_t(data) % ALN_N != 0) data++;
-
-		//cout << "alignment of data: " << (void*)data << endl;
+		allocate(uint64_t(filesize(path)));
 
 		{
 
@@ -108,6 +93,35 @@ public:
 
 	}
 
+	/*
+	 * constructor from a block source: fill(buf, len) is called once per block, in order, and must store the next
+	 * len <= BLOCK_SIZE_N characters of the string in buf[0..len-1]. Characters must be valid (no check is performed).
+	 */
+	template<class block_source>
+	dna_string_n(uint64_t n, block_source fill, char TERM = '#'){
+
+		this->TERM = TERM;
+
+		allocate(n);
+
+		string BUF(BLOCK_SIZE_N,'A');
+
+		for(uint64_t bl = 0; bl*BLOCK_SIZE_N < n; ++bl){
+
+			uint64_t len = std::min<uint64_t>(BLOCK_SIZE_N, n - bl*BLOCK_SIZE_N);
+
+			//the tail of the last block is padded with 'A'
+			if(len < BLOCK_SIZE_N) std::fill(BUF.begin() + len, BUF.end(), 'A');
+
+			fill(&BUF[0], len);
+			set(bl, BUF);
+
+		}
+
+		build_rank_support();
+
+	}
+
 	//return i-th character
 	char operator[](uint64_t i){
 
@@ -146,6 +160,149 @@ public:
 
 	}
 
+	/*
+	 * decode the i-th block to ASCII: stores its BLOCK_SIZE_N characters in out[0..BLOCK_SIZE_N-1].
+	 * out must have room for 128 characters: positions BLOCK_SIZE_N..127 are overwritten with garbage
+	 * (the partial N counters). Positions past the end of the string are decoded as 'A'.
+	 */
+	void decode_block(uint64_t i, char * out){
+
+		assert(i<n_blocks);
+
+		uint64_t superblock_number = i / BLOCKS_PER_SUPERBLOCK_N;
+		uint64_t block_number = i % BLOCKS_PER_SUPERBLOCK_N;
+
+		//code -> ASCII (see internal encoding in operator[])
+		const char lut[16] = {'A','C','G','T',TERM,'N'};
+
+		decode_planes(data + superblock_number*BYTES_PER_SUPERBLOCK_N + block_number*BYTES_PER_BLOCK_N, lut, out);
+
+		//the tail of the last block is not cleared when the string is built
+		uint64_t begin = i*BLOCK_SIZE_N;
+		if(begin + BLOCK_SIZE_N > n) std::fill(out + (n > begin ? n - begin : 0), out + BLOCK_SIZE_N, 'A');
+
+	}
+
+	/*
+	 * call f(i) for every run head i > 0 (character i differs from character i-1), in increasing order. Adjacent
+	 * characters are compared BLOCK_SIZE_N at a time: character k of a block is bit 127-k of each plane, so
+	 * plane ^ (plane >> 1) has bit 127-k set if characters k-1 and k differ in that plane.
+	 */
+	template<class F>
+	void for_each_run_head(F f){
+
+		uint64_t last = 0;//code of the last character of the previous block
+
+		for(uint64_t bl = 0; bl < n_blocks and bl*BLOCK_SIZE_N < n; ++bl){
+
+			uint64_t superblock_number = bl / BLOCKS_PER_SUPERBLOCK_N;
+			uint64_t block_number = bl % BLOCKS_PER_SUPERBLOCK_N;
+
+			__uint128_t* chars = (__uint128_t*)(data + superblock_number*BYTES_PER_SUPERBLOCK_N + block_number*BYTES_PER_BLOCK_N);
+
+			__uint128_t D = (chars[0] ^ (chars[0] >> 1)) | (chars[1] ^ (chars[1] >> 1)) | (chars[2] ^ (chars[2] >> 1));
+
+			//character 0 is compared with the last character of the previous block
+			uint64_t first = uint64_t(chars[0] >> 127) | (uint64_t(chars[1] >> 127) << 1) | (uint64_t(chars[2] >> 127) << 2);
+
+			__uint128_t top = __uint128_t(1) << 127;
+			D = bl > 0 and first != last ? D | top : D & ~top;
+
+			//only characters 0..len-1 of the block
+			uint64_t len = std::min(uint64_t(BLOCK_SIZE_N), n - bl*BLOCK_SIZE_N);
+			D &= ~((__uint128_t(1) << (128 - len)) - 1);
+
+			while(D != 0){
+
+				uint64_t hi = uint64_t(D >> 64);
+				uint64_t k = hi != 0 ? __builtin_clzll(hi) : 64 + __builtin_clzll(uint64_t(D));
+
+				f(bl*BLOCK_SIZE_N + k);
+
+				D &= ~(__uint128_t(1) << (127 - k));
+
+			}
+
+			uint64_t b = 128 - BLOCK_SIZE_N;//bit of the last character
+
+			last = uint64_t((chars[0] >> b) & 1) | (uint64_t((chars[1] >> b) & 1) << 1) | (uint64_t((chars[2] >> b) & 1) << 2);
+
+		}
+
+	}
+
+	/*
+	 * sequential access to the string starting from a given position: decodes one block at a time.
+	 */
+	class reader{
+
+	public:
+
+		reader(dna_string_n * s, uint64_t i = 0){
+
+			this->s = s;
+			block = i / BLOCK_SIZE_N;
+			off = i % BLOCK_SIZE_N;
+
+			if(block < s->n_blocks) s->decode_block(block, buf);
+
+		}
+
+		//return current character and move to the next one
+		inline char next(){
+
+			assert(block < s->n_blocks);
+
+			char c = buf[off++];
+
+			if(off == BLOCK_SIZE_N){
+
+				off = 0;
+				if(++block < s->n_blocks) s->decode_block(block, buf);
+
+			}
+
+			return c;
+
+		}
+
+		//copy the next len characters to out and move past them
+		inline void read(char * out, uint64_t len){
+
+			while(len > 0){
+
+				assert(block < s->n_blocks);
+
+				uint64_t l = std::min(len, uint64_t(BLOCK_SIZE_N) - off);
+
+				memcpy(out, buf + off, l);
+
+				out += l;
+				len -= l;
+				off += l;
+
+				if(off == BLOCK_SIZE_N){
+
+					off = 0;
+					if(++block < s->n_blocks) s->decode_block(block, buf);
+
+				}
+
+			}
+
+		}
+
+	private:
+
+		dna_string_n * s = NULL;
+
+		uint64_t block = 0;
+		uint64_t off = 0;
+
+		char buf[128];
+
+	};
+
 	/*
 	 * Parallel rank of (A,C,G,N,T) at position i.
 	 */
@@ -206,8 +363,9 @@ public:
 		out.write((char*)&nbytes,sizeof(nbytes));
 		out.write((char*)&n_superblocks,sizeof(n_superblocks));
 		out.write((char*)&n_blocks,sizeof(n_blocks));
+		out.write((char*)&TERM,sizeof(TERM));
 
-		w_bytes += sizeof(n) + sizeof(nbytes) + sizeof(n_superblocks) + sizeof(n_blocks);
+		w_bytes += sizeof(n) + sizeof(nbytes) + sizeof(n_superblocks) + sizeof(n_blocks) + sizeof(TERM);
 
 		out.write((char*)superblock_ranks.data(),n_superblocks*sizeof(p_rank_n));
 		w_bytes += n_superblocks*sizeof(p_rank_n);
@@ -225,6 +383,7 @@ public:
 		in.read((char*)&nbytes,sizeof(nbytes));
 		in.read((char*)&n_superblocks,sizeof(n_superblocks));
 		in.read((char*)&n_blocks,sizeof(n_blocks));
+		in.read((char*)&TERM,sizeof(TERM));
 
 		superblock_ranks = vector<p_rank_n>(n_superblocks);
 		in.read((char*)superblock_ranks.data(),n_superblocks*sizeof(p_rank_n));
@@ -242,8 +401,51 @@ public:
 		return n;
 	}
 
+	/*
+	 * 64-bit hash of the content (characters and counters), e.g. to check that a checkpoint was taken on the same string
+	 */
+	uint64_t checksum(){
+
+		uint64_t h = 0xcbf29ce484222325ULL ^ n;
+		uint64_t * words = (uint64_t*)data;
+
+		for(uint64_t i=0;i<nbytes/8;++i){
+
+			h = (h ^ words[i]) * 0x100000001b3ULL;
+			h ^= h >> 32;
+
+		}
+
+		return h;
+
+	}
+
 private:
 
+	/*
+	 * allocate memory for a string of length n. Data is filled with 0s.
+	 */
+	void allocate(uint64_t n){
+
+		this->n = n;
+
+		n_superblocks = (n+1)/SUPERBLOCK_SIZE_N_N + ((n+1)%SUPERBLOCK_SIZE_N_N != 0);
+		n_blocks = (n+1)/BLOCK_SIZE_N + ((n+1)%BLOCK_SIZE_N != 0);
+		nbytes = (n_blocks * BYTES_PER_BLOCK_N);//number of bytes effectively filled with data
+
+		superblock_ranks = vector<p_rank_n>(n_superblocks);
+
+		/*
+		 * this block of code ensures that data is aligned by 64 bytes = 512 bits
+		 */
+		memory = vector<uint8_t>(nbytes+ALN_N,0);
+		data = memory.data();
+		while(uint64_t(data) % ALN_N != 0) data++;
+
+		//cout << "alignment of data: " << (void*)data << endl;
+
+	}
+
 	void build_rank_support(){
 
 		p_rank_n superblock_r = {};
@@ -5,10 +5,17 @@
 #ifndef INCLUDE_HPP_
 #define INCLUDE_HPP_
 
+#include <iostream>
 #include <fstream>
 #include <vector>
 #include <cassert>
 #include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_SSSE3_DISPATCH
+#include <tmmintrin.h>
+#endif
 
 using namespace std;
 
@@ -67,11 +74,16 @@ struct sa_node_n{
 
 };
 
+bool is_index(string filename);
+uint8_t index_sigma(string filename);
+
 /*
- * file contains 'N' characters
+ * file contains 'N' characters. If file is a packed BWT index, check its alphabet.
  */
 bool hasN(string filename){
 
+	if(is_index(filename)) return index_sigma(filename) == 6;
+
 	std:ifstream i(filename);
 
 	char c;
@@ -86,6 +98,42 @@ bool hasN(string filename){
 
 }
 
+/*
+ * packed BWT index files (see dna_bwt::serialize) start with these 4 Bytes, followed by one Byte containing the
+ * alphabet size (5 = {A,C,G,T,TERM}, 6 = {A,C,G,N,T,TERM}). No ASCII BWT can start with them.
+ */
+#define INDEX_MAGIC "DBWT"
+
+/*
+ * file is a packed BWT index rather than an ASCII BWT
+ */
+bool is_index(string filename){
+
+	std::ifstream i(filename);
+
+	char magic[4] = {};
+	i.read(magic, 4);
+
+	return i.gcount() == 4 and std::equal(magic, magic+4, INDEX_MAGIC);
+
+}
+
+/*
+ * alphabet size stored in a packed BWT index file
+ */
+uint8_t index_sigma(string filename){
+
+	std::ifstream i(filename);
+
+	i.seekg(4);
+
+	char sigma = 0;
+	i.get(sigma);
+
+	return sigma;
+
+}
+
 uint64_t node_size(sa_node s){
 	return s.last - s.first_TERM;
 }
@@ -339,6 +387,75 @@ inline uint64_t popcount128(__uint128_t x){
 
 }
 
+/*
+ * spread the 8 bits of b (most significant first) to the lowest bits of the 8 Bytes of a 64-bit word (lowest Byte first).
+ * Each term of the multiplication moves a copy of b by 9 bits, so no two copies overlap and there are no carries.
+ */
+inline uint64_t spread_bits(uint8_t b){
+
+	return ((uint64_t(b) * 0x8040201008040201ULL) >> 7) & 0x0101010101010101ULL;
+
+}
+
+#ifdef HAS_SSSE3_DISPATCH
+
+/*
+ * out[i] = lut[codes[i]] for i = 0..127, 16 characters per shuffle. Compiled for SSSE3 independently of the build
+ * flags, and called only if the CPU supports it (see decode_planes).
+ */
+__attribute__((target("ssse3"))) inline void lut_shuffle_ssse3(const uint8_t * codes, const char * lut, char * out){
+
+	__m128i L = _mm_loadu_si128((__m128i*)lut);
+
+	for(int k=0;k<8;++k){
+
+		__m128i C = _mm_loadu_si128((__m128i*)(codes + 16*k));
+		_mm_storeu_si128((__m128i*)(out + 16*k), _mm_shuffle_epi8(L, C));
+
+	}
+
+}
+
+#endif
+
+/*
+ * decode a 512-bit block made of three 128-bit planes (1st, 2nd, 3rd bits of 128 3-bit codes, first character
+ * in the most significant bit) starting at address start. Stores the ASCII characters in out[0..127]:
+ * character with code c is mapped to lut[c].
+ */
+inline void decode_planes(uint8_t * start, const char * lut, char * out){
+
+	//codes[i] = 3-bit code of the i-th character
+	uint8_t codes[128];
+
+	for(int k=0;k<16;++k){
+
+		//characters 8k..8k+7 are stored in the (15-k)-th Byte of each __uint128_t plane
+		uint64_t c = 	spread_bits(start[15-k]) |
+						(spread_bits(start[31-k]) << 1) |
+						(spread_bits(start[47-k]) << 2);
+
+		memcpy(codes + 8*k, &c, 8);
+
+	}
+
+#ifdef HAS_SSSE3_DISPATCH
+
+	static const bool ssse3 = __builtin_cpu_supports("ssse3");
+
+	if(ssse3){
+
+		lut_shuffle_ssse3(codes, lut, out);
+		return;
+
+	}
+
+#endif
+
+	for(int i=0;i<128;++i) out[i] = lut[codes[i]];
+
+}
+
 range_t child_TERM(sa_node x){
 	return {x.first_TERM, x.first_A};
 }
@@ -475,8 +592,12 @@ uint8_t number_of_children(pair<sa_node_n,sa_node_n> P){
 
 }
 
-template<typename lcp_int_t>
-void update_lcp(sa_node & x, vector<lcp_int_t> & LCP, uint64_t & lcp_values){
+/*
+ * set LCP values at the borders of x's children. If fill_missing, only positions still
+ * equal to nil are written (the others already contain x.depth).
+ */
+template<typename lcp_int_t, class lcp_array_t>
+void update_lcp(sa_node & x, lcp_array_t & LCP, uint64_t & lcp_values, bool fill_missing = false){
 
 	assert(x.first_A >= x.first_TERM);
 	assert(x.first_C >= x.first_A);
@@ -487,22 +608,22 @@ void update_lcp(sa_node & x, vector<lcp_int_t> & LCP, uint64_t & lcp_values){
 
 	lcp_int_t nil = ~lcp_int_t(0);
 
-	if(has_child_TERM(x) and x.first_A != x.last){
+	if(has_child_TERM(x) and x.first_A != x.last and (not fill_missing or LCP[x.first_A]==nil)){
 		assert(LCP[x.first_A]==nil);
 		LCP[x.first_A] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_A(x) and x.first_C != x.last){
+	if(has_child_A(x) and x.first_C != x.last and (not fill_missing or LCP[x.first_C]==nil)){
 		assert(LCP[x.first_C]==nil);
 		LCP[x.first_C] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_C(x) and x.first_G != x.last){
+	if(has_child_C(x) and x.first_G != x.last and (not fill_missing or LCP[x.first_G]==nil)){
 		assert(LCP[x.first_G]==nil);
 		LCP[x.first_G] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_G(x) and x.first_T != x.last){
+	if(has_child_G(x) and x.first_T != x.last and (not fill_missing or LCP[x.first_T]==nil)){
 		assert(LCP[x.first_T]==nil);
 		LCP[x.first_T] = x.depth;
 		lcp_values++;
@@ -510,8 +631,12 @@ void update_lcp(sa_node & x, vector<lcp_int_t> & LCP, uint64_t & lcp_values){
 
 }
 
-template<typename lcp_int_t>
-void update_lcp(sa_node_n & x, vector<lcp_int_t> & LCP, uint64_t & lcp_values){
+/*
+ * set LCP values at the borders of x's children. If fill_missing, only positions still
+ * equal to nil are written (the others already contain x.depth).
+ */
+template<typename lcp_int_t, class lcp_array_t>
+void update_lcp(sa_node_n & x, lcp_array_t & LCP, uint64_t & lcp_values, bool fill_missing = false){
 
 	assert(x.first_A >= x.first_TERM);
 	assert(x.first_C >= x.first_A);
@@ -523,27 +648,27 @@ void update_lcp(sa_node_n & x, vector<lcp_int_t> & LCP, uint64_t & lcp_values){
 
 	lcp_int_t nil = ~lcp_int_t(0);
 
-	if(has_child_TERM(x) and x.first_A != x.last){
+	if(has_child_TERM(x) and x.first_A != x.last and (not fill_missing or LCP[x.first_A]==nil)){
 		assert(LCP[x.first_A]==nil);
 		LCP[x.first_A] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_A(x) and x.first_C != x.last){
+	if(has_child_A(x) and x.first_C != x.last and (not fill_missing or LCP[x.first_C]==nil)){
 		assert(LCP[x.first_C]==nil);
 		LCP[x.first_C] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_C(x) and x.first_G != x.last){
+	if(has_child_C(x) and x.first_G != x.last and (not fill_missing or LCP[x.first_G]==nil)){
 		assert(LCP[x.first_G]==nil);
 		LCP[x.first_G] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_G(x) and x.first_N != x.last){
+	if(has_child_G(x) and x.first_N != x.last and (not fill_missing or LCP[x.first_N]==nil)){
 		assert(LCP[x.first_N]==nil);
 		LCP[x.first_N] = x.depth;
 		lcp_values++;
 	}
-	if(has_child_N(x) and x.first_T != x.last){
+	if(has_child_N(x) and x.first_T != x.last and (not fill_missing or LCP[x.first_T]==nil)){
 		assert(LCP[x.first_T]==nil);
 		LCP[x.first_T] = x.depth;
 		lcp_values++;
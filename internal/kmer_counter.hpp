@@ -0,0 +1,468 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * kmer_counter.hpp
+ *
+ *  Created on: Jan 27, 2019
+ *      Author: nico
+ *
+ *  k-mer spectrum of a collection from its BWT, using only rank operations on the packed BWT: all distinct k-mers
+ *  (over A,C,G,T) occurring at least min_count times, with their number of occurrences, or just the histogram of
+ *  the counts.
+ *
+ *  k-mers are spelled by left extensions (Weiner links) of BWT ranges from the empty string down to depth k; ranges
+ *  with fewer than min_count suffixes are not extended. The ranges at a small depth (the frontier, in Weiner order)
+ *  are the independent tasks of the parallel traversal (class kmer_traversal): tasks are processed in rounds of
+ *  4*n_threads, and their outputs are consumed in task order, so the Weiner order is preserved. The traversal also
+ *  navigates pairs of ranges, one per BWT, for the k-mers of two collections (see diff_kmers.hpp).
+ *
+ *  Orders:
+ *
+ *  	weiner          colexicographic order (sorted by reversed k-mer), as visited. Streamed: no extra memory. Default
+ *  	                of bwt2kmers.
+ *  	lexicographic   records are kept in RAM (16 Bytes per reported k-mer) and sorted before being written.
+ *
+ *  Output file (k-mers): a header of 64-bit little-endian words
+ *
+ *  	[0]          magic "DKMC", then version (1 Byte), then 3 Bytes = 0
+ *  	[1]          k
+ *  	[2]          number of k-mers
+ *
+ *  followed by one record of 2 words per k-mer: the k-mer (2 bits per base, A=0 C=1 G=2 T=3, first base in the most
+ *  significant position) and its count.
+ *
+ *  Output file (histogram): ASCII, one line "count<TAB>number of k-mers with that count" per count, increasing.
+ *
+ */
+
+#ifndef INTERNAL_KMER_COUNTER_HPP_
+#define INTERNAL_KMER_COUNTER_HPP_
+
+#define KMC_MAGIC "DKMC"
+#define KMC_VERSION 1
+#define KMC_HEADER_WORDS 3
+#define KMC_MAX_K 32
+#define KMC_TASKS_PER_THREAD 64 //the frontier is deepened until it has this many ranges per thread
+#define KMC_DENSE_HIST 65536 //counts below this are histogrammed in an array, the others in a map
+
+#include "include.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * a string W of length depth (2 bits per base, first base most significant) and its BWT range
+ */
+struct kmer_range{
+
+	range_t rn;
+	uint64_t depth;
+	uint64_t kmer;
+
+};
+
+/*
+ * a string W of length depth and its range in each of two BWTs
+ */
+struct kmer_range_pair{
+
+	range_t r1;
+	range_t r2;
+	uint64_t depth;
+	uint64_t kmer;
+
+};
+
+/*
+ * header of a k-mer file: words [0] = magic and version, [1] = k, [2] = number of k-mers
+ */
+inline void write_kmer_header(ofstream & out, uint64_t k, uint64_t kmers){
+
+	uint64_t header[KMC_HEADER_WORDS] = {0, k, kmers};
+
+	char * magic = (char*)header;
+	std::memcpy(magic, KMC_MAGIC, 4);
+	magic[4] = KMC_VERSION;
+
+	out.write((char*)header, KMC_HEADER_WORDS*sizeof(uint64_t));
+
+}
+
+/*
+ * parallel navigation of the k-mers of a BWT occurring at least min_count times (kmer_t = kmer_range), or of the
+ * k-mers of two BWTs occurring at least min_count times in the first and min_count2 times in the second
+ * (kmer_t = kmer_range_pair)
+ */
+template<class bwt_t, class kmer_t = kmer_range>
+class kmer_traversal{
+
+public:
+
+	kmer_traversal(bwt_t * bwt, uint64_t k, uint64_t min_count) : bwt(bwt), k(k), min_count(min_count) {
+
+		assert(k > 0 and k <= KMC_MAX_K);
+		assert(min_count > 0);
+
+	}
+
+	kmer_traversal(bwt_t * bwt1, bwt_t * bwt2, uint64_t k, uint64_t min_count1, uint64_t min_count2) :
+		bwt(bwt1), bwt2(bwt2), k(k), min_count(min_count1), min_count2(min_count2) {
+
+		assert(k > 0 and k <= KMC_MAX_K);
+
+	}
+
+	/*
+	 * call on_kmer(W, buf, t) on each k-mer W with n_threads threads (t = index of the calling thread), which appends
+	 * records of type record_t to buf. consume(buf) is called by this thread on the records of all k-mers, in Weiner
+	 * order. P is updated with the number of settled suffixes.
+	 */
+	template<typename record_t, class on_kmer_t, class consume_t>
+	void run(uint64_t n_threads, progress & P, on_kmer_t on_kmer, consume_t consume){
+
+		//FRONTIER: ranges at the smallest depth with at least KMC_TASKS_PER_THREAD ranges per thread (or k), in Weiner order
+
+		vector<kmer_t> frontier = {root()};
+
+		uint64_t done = 0;//suffixes whose range has been settled
+
+		while(frontier.size() > 0 and frontier[0].depth < k and frontier.size() < KMC_TASKS_PER_THREAD*n_threads){
+
+			vector<kmer_t> next;
+
+			for(auto & W : frontier){
+
+				vector<kmer_t> E;
+				done += size(W) - extend(W, E);
+
+				//extensions were pushed in decreasing order of character
+				next.insert(next.end(), E.rbegin(), E.rend());
+
+			}
+
+			ranges += frontier.size();
+			frontier = next;
+
+		}
+
+		//TRAVERSAL: one task per frontier range
+
+		uint64_t round = 4*n_threads;//tasks per round
+
+		vector<vector<record_t> > buf(round);
+		vector<uint64_t> task_ranges(round);
+
+		for(uint64_t begin = 0; begin < frontier.size(); begin += round){
+
+			uint64_t end = std::min<uint64_t>(frontier.size(), begin + round);
+
+			atomic<uint64_t> next_task(begin);
+			vector<thread> T;
+
+			for(uint64_t t = 0; t < n_threads; ++t){
+
+				T.push_back(thread([&, t](){
+
+					uint64_t i;
+
+					while((i = next_task.fetch_add(1)) < end){
+
+						buf[i-begin].clear();
+						task_ranges[i-begin] = visit(frontier[i], buf[i-begin], t, on_kmer);
+
+					}
+
+				}));
+
+			}
+
+			for(auto & t : T) t.join();
+
+			for(uint64_t i = begin; i < end; ++i){
+
+				done += size(frontier[i]);
+				ranges += task_ranges[i-begin];
+
+				consume(buf[i-begin]);
+
+			}
+
+			P.update(ranges, 0, done);
+
+		}
+
+	}
+
+	/*
+	 * number of visited ranges
+	 */
+	uint64_t visited(){
+		return ranges;
+	}
+
+private:
+
+	/*
+	 * DFS from W. Returns the number of visited ranges.
+	 */
+	template<typename record_t, class on_kmer_t>
+	uint64_t visit(kmer_t W, vector<record_t> & buf, uint64_t t, on_kmer_t & on_kmer){
+
+		vector<kmer_t> S = {W};
+		uint64_t visited = 0;
+
+		while(not S.empty()){
+
+			W = S.back();
+			S.pop_back();
+			visited++;
+
+			if(W.depth < k) extend(W, S);
+			else on_kmer(W, buf, t);
+
+		}
+
+		return visited;
+
+	}
+
+	kmer_t root(){
+
+		kmer_t W = {};
+		set_root(W);
+
+		return W;
+
+	}
+
+	void set_root(kmer_range & W){
+
+		W.rn = {0, bwt->size()};
+
+	}
+
+	void set_root(kmer_range_pair & W){
+
+		W.r1 = {0, bwt->size()};
+		W.r2 = {0, bwt2->size()};
+
+	}
+
+	//number of suffixes in the range(s) of W
+	static uint64_t size(kmer_range & W){
+		return range_length(W.rn);
+	}
+
+	static uint64_t size(kmer_range_pair & W){
+		return range_length(W.r1) + range_length(W.r2);
+	}
+
+	uint64_t extend(kmer_range & W, vector<kmer_range> & S){
+		return extend(bwt->LF(W.rn), W, S);
+	}
+
+	uint64_t extend(kmer_range_pair & W, vector<kmer_range_pair> & S){
+		return extend(bwt->LF(W.r1), bwt2->LF(W.r2), W, S);
+	}
+
+	/*
+	 * push on S the extensions cW with at least min_count suffixes, in decreasing order of c (so that A is
+	 * popped first). Returns the number of suffixes in the pushed ranges.
+	 */
+	uint64_t extend(p_range e, kmer_range & W, vector<kmer_range> & S){
+
+		return push(e.T, 3, W, S) + push(e.G, 2, W, S) + push(e.C, 1, W, S) + push(e.A, 0, W, S);
+
+	}
+
+	//k-mers containing N are not visited
+	uint64_t extend(p_range_n e, kmer_range & W, vector<kmer_range> & S){
+
+		return push(e.T, 3, W, S) + push(e.G, 2, W, S) + push(e.C, 1, W, S) + push(e.A, 0, W, S);
+
+	}
+
+	inline uint64_t push(range_t rn, uint64_t c, kmer_range & W, vector<kmer_range> & S){
+
+		uint64_t size = range_length(rn);
+
+		if(size < min_count) return 0;
+
+		S.push_back({rn, W.depth+1, W.kmer | (c << (2*W.depth))});
+
+		return size;
+
+	}
+
+	/*
+	 * the same for pairs: cW is pushed if it occurs at least min_count times in BWT 1 and min_count2 times in BWT 2
+	 */
+	uint64_t extend(p_range e1, p_range e2, kmer_range_pair & W, vector<kmer_range_pair> & S){
+
+		return push(e1.T, e2.T, 3, W, S) + push(e1.G, e2.G, 2, W, S) + push(e1.C, e2.C, 1, W, S) + push(e1.A, e2.A, 0, W, S);
+
+	}
+
+	uint64_t extend(p_range_n e1, p_range_n e2, kmer_range_pair & W, vector<kmer_range_pair> & S){
+
+		return push(e1.T, e2.T, 3, W, S) + push(e1.G, e2.G, 2, W, S) + push(e1.C, e2.C, 1, W, S) + push(e1.A, e2.A, 0, W, S);
+
+	}
+
+	inline uint64_t push(range_t r1, range_t r2, uint64_t c, kmer_range_pair & W, vector<kmer_range_pair> & S){
+
+		uint64_t c1 = range_length(r1);
+		uint64_t c2 = range_length(r2);
+
+		if(c1 + c2 == 0 or c1 < min_count or c2 < min_count2) return 0;
+
+		S.push_back({r1, r2, W.depth+1, W.kmer | (c << (2*W.depth))});
+
+		return c1 + c2;
+
+	}
+
+	bwt_t * bwt = NULL;
+	bwt_t * bwt2 = NULL;//second BWT, if kmer_t = kmer_range_pair
+
+	uint64_t k = 0;
+	uint64_t min_count = 1;
+	uint64_t min_count2 = 0;
+
+	uint64_t ranges = 0;//visited ranges
+
+};
+
+template<class bwt_t>
+class kmer_counter{
+
+public:
+
+	enum order_t {weiner, lexicographic};
+
+	/*
+	 * count the k-mers (1 <= k <= KMC_MAX_K) of bwt occurring at least min_count >= 1 times. If histogram is false,
+	 * stream them in the given order to file path, otherwise store the histogram of their counts to path.
+	 * n_threads = 0: number of hardware threads.
+	 */
+	kmer_counter(bwt_t * bwt, uint64_t k, uint64_t min_count, order_t order, bool histogram, string path, uint64_t n_threads = 0){
+
+		if(n_threads == 0) n_threads = std::max<uint64_t>(1, thread::hardware_concurrency());
+
+		ofstream out(path, ios::binary);
+
+		if(not out.good()){
+
+			cout << "Error: cannot open output file " << path << endl;
+			exit(1);
+
+		}
+
+		if(not histogram and order == weiner) write_kmer_header(out, k, 0);
+
+		cout << "\nNavigating the " << k << "-mers occurring at least " << min_count << " times." << endl;
+
+		stats.begin_phase("kmers");
+
+		progress P("kmers", bwt->size(), {"suffixes"});
+
+		kmer_traversal<bwt_t> T(bwt, k, min_count);
+
+		vector<vector<uint64_t> > dense(n_threads, vector<uint64_t>(histogram ? KMC_DENSE_HIST : 0));
+		vector<map<uint64_t, uint64_t> > sparse(n_threads);
+
+		vector<record_t> sorted;//records, if sorted in lexicographic order
+
+		T.template run<record_t>(n_threads, P, [&](kmer_range & W, vector<record_t> & buf, uint64_t t){
+
+			uint64_t c = range_length(W.rn);
+
+			if(not histogram) buf.push_back({W.kmer, c});
+			else if(c < KMC_DENSE_HIST) dense[t][c]++;
+			else sparse[t][c]++;
+
+		}, [&](vector<record_t> & buf){
+
+			if(histogram) return;
+
+			kmers += buf.size();
+			for(auto & r : buf) occurrences += r.second;
+
+			if(order == weiner) out.write((char*)buf.data(), buf.size()*sizeof(record_t));
+			else sorted.insert(sorted.end(), buf.begin(), buf.end());
+
+		});
+
+		P.stop();
+
+		if(not histogram and order == lexicographic){
+
+			std::sort(sorted.begin(), sorted.end());
+
+			write_kmer_header(out, k, 0);
+			out.write((char*)sorted.data(), sorted.size()*sizeof(record_t));
+
+		}
+
+		if(histogram){
+
+			map<uint64_t, uint64_t> H;
+
+			for(uint64_t t = 0; t < n_threads; ++t){
+
+				for(uint64_t c = 0; c < KMC_DENSE_HIST; ++c) if(dense[t][c] > 0) H[c] += dense[t][c];
+				for(auto & e : sparse[t]) H[e.first] += e.second;
+
+			}
+
+			for(auto & e : H){
+
+				out << e.first << "\t" << e.second << "\n";
+				kmers += e.second;
+				occurrences += e.first*e.second;
+
+			}
+
+		}else{
+
+			out.seekp(0);
+			write_kmer_header(out, k, kmers);
+
+		}
+
+		out.close();
+
+		cout << "Visited " << T.visited() << " ranges. Found " << kmers << " distinct " << k << "-mers (" << occurrences << " occurrences)." << endl;
+
+		stats.end_phase(T.visited());
+
+		stats.set("k", k);
+		stats.set("min_count", min_count);
+		stats.set("kmers", kmers);
+		stats.set("kmer_occurrences", occurrences);
+		stats.set("bytes_written", uint64_t(filesize(path)));
+
+	}
+
+	run_stats stats;//time spent in each phase, counters
+
+private:
+
+	typedef pair<uint64_t, uint64_t> record_t;//k-mer, count
+
+	uint64_t kmers = 0;//reported k-mers
+	uint64_t occurrences = 0;//sum of their counts
+
+};
+
+#endif /* INTERNAL_KMER_COUNTER_HPP_ */
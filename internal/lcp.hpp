@@ -14,6 +14,33 @@
  *
  * RAM n*(B+0.5) Bytes, where B = sizeof(lcp_int_t) is the number of Bytes needed to represent an LCP value.
  *
+ * Optionally, the traversal state is periodically checkpointed (see checkpoint.hpp): the LCP is then stored in
+ * a file-backed array, and an interrupted run can be resumed from its last checkpoint.
+ *
+ * Optionally, the LCP is a shared mapping of the output file: it is not copied at the end, and the kernel can page
+ * it out under memory pressure (RAM n*0.5 Bytes plus the page cache).
+ *
+ * Optionally, only min(LCP, K) is computed: leaves and nodes of depth >= K are not visited, and the positions
+ * left empty (whose LCP is at least K) are set to K at the end.
+ *
+ * Optionally, only the LCP values at the run boundaries of the BWT are stored (see sampled_lcp.hpp): the LCP array
+ * is not allocated (RAM n*0.5 Bytes plus O(r)).
+ *
+ * LCP histogram, node and leaf sizes are collected during the traversal and stored in the run statistics (see
+ * lcp_stats.hpp), except after a resume.
+ *
+ * Optional analyses, in the same process:
+ *
+ * 	- maximal repeats: the nodes pass streams the maximal repeats W with |W| >= L (each terminator being a distinct
+ * 	  character, see repeats.hpp) to a repeats file: the left-maximal suffix-tree nodes, and the left-maximal terminal
+ * 	  strings reached from them by Weiner links. One record of 3 words per repeat: |W|, number of occurrences, begin.
+ * 	  W occupies the BWT interval [begin, begin+count).
+ *
+ * 	- shortest unique substrings: save_sus computes, for each BWT position i, the length SUS[i] = 1 + max(LCP[i],
+ * 	  LCP[i+1]) (LCP[n] = 0) of the shortest prefix of the i-th suffix occurring only once in the collection, from
+ * 	  the LCP in RAM (or in the mapped output file), while writing it. A value larger than the length of the suffix
+ * 	  means that the whole suffix occurs elsewhere (then only the terminator makes it unique).
+ *
  * Based on an extension (to BWTs of collections) of the suffix-tree navigation algorithm described in
  *
  * "Linear time construction of compressed text indices in compact space" by Djamal Belazzougui.
@@ -25,178 +52,542 @@
 
 #include "dna_bwt.hpp"
 #include "include.hpp"
+#include "output_writer.hpp"
+#include "compressed_lcp.hpp"
+#include "progress.hpp"
+#include "checkpoint.hpp"
+#include "mmap_array.hpp"
+#include "stats.hpp"
+#include "st_traversal.hpp"
+#include "sampled_lcp.hpp"
+#include "repeats.hpp"
+#include "lcp_stats.hpp"
 #include <stack>
+#include <memory>
 #include <algorithm>
 
 using namespace std;
 
+#define REP_LCP_RECORD_WORDS 3
+
+/*
+ * options of class lcp
+ */
+struct lcp_options{
+
+	//if not empty, save a checkpoint every ckpt_seconds seconds in files ckpt_path.ckpt (traversal state) and
+	//ckpt_path.ckpt.lcp (LCP array)
+	string ckpt_path = "";
+	uint64_t ckpt_seconds = 0;
+
+	//resume from the checkpoint in ckpt_path (if any) instead of starting from scratch
+	bool resume = false;
+
+	//if not empty, the LCP is built directly in this file (memory mapped), which is also used as checkpoint file for
+	//the LCP. save_to_file(lcp_path) then has nothing to write.
+	string lcp_path = "";
+
+	//if > 0, compute min(LCP, depth_cap) (depth_cap must be smaller than the largest value of lcp_int_t)
+	uint64_t depth_cap = 0;
+
+	//store only the values at the run boundaries of the BWT in SLCP (LCP stays empty). Not compatible with
+	//checkpoints and lcp_path.
+	bool run_sampled = false;
+
+	//if not empty, stream to this file the maximal repeats of length >= min_repeat. Not compatible with checkpoints
+	//and depth_cap.
+	string repeats_path = "";
+	uint64_t min_repeat = 1;
+
+};
+
 template<class bwt_t, typename lcp_int_t>
 class lcp{
 
 public:
 
 	/*
-	 * Build LCP from BWT. Parameters:
-	 *
+	 * Build LCP from BWT, with the given options (see lcp_options).
 	 */
-	lcp(bwt_t * bwt){
+	lcp(bwt_t * bwt, lcp_options opt = lcp_options()){
 
-		this->bwt;
+		this->bwt = bwt;
 
 		n = bwt->size();
 
-		LCP = vector<lcp_int_t>(n, nil);
-		LCP[0] = 0;
+		assert(opt.depth_cap < nil);
 
-		/*
-		 * FIRST PASS: LEAVES NAVIGATION. COMPUTE LCP VALUES INSIDE SUFFIX TREE LEAVES.
-		 */
+		//no cap: all depths are smaller than nil
+		K = opt.depth_cap > 0 ? opt.depth_cap : nil;
 
-		cout << "\nNow navigating suffix tree leaves of size >= 2 to compute internal LCP values." << endl;
+		uint64_t phase = LEAVES;//phase to start from
+		vector<uint64_t> counters;//counters of the checkpoint
 
-		uint64_t m = 0;//portion of text covered by visited leaves
-		uint64_t leaves = 0;//number of visited leaves
-		uint64_t max_stack = 0;
-		uint64_t lcp_values = 1;//number of filled LCP values
+		this->run_sampled = opt.run_sampled;
 
-		{
+		find_repeats = opt.repeats_path.size()>0;
+		this->min_repeat = opt.min_repeat;
 
-			auto TMP_LEAVES = vector<sa_leaf>(5);
+		if(find_repeats) TS = terminal_strings<bwt_t, 1>(bwt, NULL, min_repeat);
 
-			stack<sa_leaf> S;
+		assert(not find_repeats or (opt.ckpt_path.size()==0 and opt.depth_cap == 0));
 
-			sa_leaf root = bwt->first_leaf();
-			S.push(root);
+		if(run_sampled){
 
-			int last_perc = -1;
-			int perc = 0;
+			assert(opt.ckpt_path.size()==0 and opt.lcp_path.size()==0);
 
-			while(not S.empty()){
+			SLCP = sampled_lcp<lcp_int_t>(*bwt, nil);
+			SLCP[0] = 0;
 
-				sa_leaf L = S.top();
-				S.pop();
-				leaves++;
+			cout << "Sampled " << SLCP.samples() << " positions at the run boundaries of the BWT." << endl;
 
-				max_stack = S.size() > max_stack ? S.size() : max_stack;
+		}else if(opt.ckpt_path.size()>0){
 
-				assert(L.rn.second > L.rn.first);
+			ckpt = checkpoint(opt.ckpt_path + ".ckpt", opt.ckpt_seconds, {n, sizeof(lcp_int_t), opt.depth_cap, bwt->checksum()});
+			lcp_file = opt.lcp_path.size()>0 ? opt.lcp_path : opt.ckpt_path + ".ckpt.lcp";
 
-				for(uint64_t i = L.rn.first+1; i<L.rn.second; ++i){
+			resumed = opt.resume and ckpt.load(phase, counters);
 
-					assert(LCP[i]==nil);
+			if(opt.resume and not resumed) cout << "No checkpoint found in " << opt.ckpt_path << ".ckpt: starting from scratch." << endl;
 
-					LCP[i] = L.depth;
+			LCP = mmap_array<lcp_int_t>(lcp_file, n, nil, resumed);
 
-					lcp_values++;
-					m++;
+		}else if(opt.lcp_path.size()>0){
 
-				}
+			lcp_file = opt.lcp_path;
+			LCP = mmap_array<lcp_int_t>(lcp_file, n, nil, false);
+
+		}else{
 
-				m++;
+			LCP = mmap_array<lcp_int_t>(n, nil);
 
-				assert(m<=n);
+		}
 
-				int t = 0;
+		if(not run_sampled) LCP[0] = 0;
 
-				bwt->next_leaves(L, TMP_LEAVES, t, 2);
+		uint64_t leaves = 0;//number of visited leaves
+		uint64_t max_stack = 0;
 
-				for(int i=t-1;i>=0;--i) S.push(TMP_LEAVES[i]);
+		if(resumed){
 
-				perc = (100*lcp_values)/n;
+			//the LCP may also contain values computed after the checkpoint
+			lcp_values = n - std::count(LCP.data(), LCP.data()+n, nil);
 
-				if(perc > last_perc){
+			cout << "Resuming from checkpoint: phase " << (phase == LEAVES ? "leaves" : "nodes") << ", " << lcp_values << "/" << n << " LCP values already computed." << endl;
 
-					cout << "LCP: " << perc << "%." << endl;
-					last_perc = perc;
+		}
 
-				}
+		auto T = st_traversal<single_tree<bwt_t> >(single_tree<bwt_t>(bwt));
+
+		//after a resume from the nodes phase, the leaves have already been navigated
+		if(phase == LEAVES){
+
+			/*
+			 * FIRST PASS: LEAVES NAVIGATION. COMPUTE LCP VALUES INSIDE SUFFIX TREE LEAVES.
+			 */
+
+			cout << "\nNow navigating suffix tree leaves of size >= 2 to compute internal LCP values." << endl;
+
+			stats.begin_phase("leaves");
+
+			stack<sa_leaf> S;
+
+			if(resumed){
+
+				S = ckpt.get_stack<sa_leaf>();
+				leaves = counters[0];
+				max_stack = counters[1];
+				m = counters[2];
+
+			}else{
+
+				S.push(T.first_leaf());
 
 			}
-		}
 
-		cout << "Visited leaves cover " << m << "/" << n << " input characters." << endl;
-		cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
+			P.reset(new progress("leaves", n, {"LCP"}, lcp_values));
+
+			T.visit_leaves(*this, S, leaves, max_stack, 2);
 
-		cout << "Max stack size = " << max_stack << endl;
-		cout << "Processed " << leaves << " suffix-tree leaves of size >= 2." << endl;
+			P->stop();
+
+			cout << "Visited leaves cover " << m << "/" << n << " input characters." << endl;
+			cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
+
+			cout << "Max stack size = " << max_stack << endl;
+			cout << "Processed " << leaves << " suffix-tree leaves of size >= 2." << endl;
+
+			stats.end_phase(leaves, max_stack);
+			stats.print_counters(n, "leaf");
+
+		}
 
 		cout << "\nNow navigating suffix tree nodes to compute remaining LCP values." << endl;
 
-		{
+		stats.begin_phase("nodes");
 
-			auto TMP_NODES = vector<typename bwt_t::sa_node_t>(5);
+		if(find_repeats) REP = repeat_writer(opt.repeats_path, min_repeat, REP_LCP_RECORD_WORDS);
+
+		{
 
 			uint64_t nodes = 0;//visited ST nodes
 			max_stack = 0;
 
 			stack<typename bwt_t::sa_node_t> S;
 
-			typename bwt_t::sa_node_t root = bwt->root();
+			if(resumed and phase == NODES){
 
-			S.push(root);
+				S = ckpt.get_stack<typename bwt_t::sa_node_t>();
+				nodes = counters[0];
+				max_stack = counters[1];
 
-			int last_perc = -1;
-			int perc = 0;
+			}else{
 
-			while(not S.empty()){
+				S.push(T.root());
 
-				max_stack = S.size() > max_stack ? S.size() : max_stack;
+				//the leaves will not be repeated if the run is interrupted from now on
+				if(ckpt.enabled()) save_checkpoint(NODES, {nodes, max_stack}, S);
 
-				typename bwt_t::sa_node_t N = S.top();
-				S.pop();
-				nodes++;
+			}
 
-				update_lcp<lcp_int_t>(N,LCP,lcp_values);
+			P.reset(new progress("nodes", n, {"LCP"}, lcp_values));
 
-				int t = 0;
+			T.visit_nodes(*this, S, nodes, max_stack);
 
-				bwt->next_nodes(N, TMP_NODES, t);
+			P->stop();
 
-				for(int i=t-1;i>=0;--i){
+			cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
+			cout << "Max stack size = " << max_stack << endl;
+			cout << "Processed " << nodes << " suffix-tree nodes." << endl;
 
-					S.push(TMP_NODES[i]);
+			stats.end_phase(nodes, max_stack);
+			stats.print_counters(n, "node");
 
-				}
+		}
+
+		if(find_repeats){
+
+			REP.close();
+
+			cout << "Found " << REP.size() << " maximal repeats of length >= " << min_repeat << " (stored to " << opt.repeats_path << ")." << endl;
+
+			stats.set("min_repeat", min_repeat);
+			stats.set("repeats", REP.size());
+
+		}
 
-				perc = (100*lcp_values)/n;
+		if(opt.depth_cap > 0){
 
-				if(perc > last_perc){
+			cout << "\nSetting the remaining " << n - lcp_values << " LCP values to " << opt.depth_cap << "." << endl;
 
-					cout << "LCP: " << perc << "%." << endl;
-					last_perc = perc;
+			H[NODES].add_lcp(opt.depth_cap, n - lcp_values);
+
+			if(run_sampled){
+
+				lcp_values = n;
+				std::replace(SLCP.data(), SLCP.data() + SLCP.samples(), nil, lcp_int_t(opt.depth_cap));
+
+			}else{
+
+				for(uint64_t i=0;i<n;++i){
+
+					lcp_values += LCP[i]==nil;
+					LCP[i] = LCP[i]==nil ? opt.depth_cap : LCP[i];
 
 				}
 
 			}
 
-			cout << "Computed " << lcp_values << "/" << n << " LCP values." << endl;
-			cout << "Max stack size = " << max_stack << endl;
-			cout << "Processed " << nodes << " suffix-tree nodes." << endl;
+			stats.set("depth_cap", opt.depth_cap);
 
 		}
 
+		//the counters of the phases before a checkpoint are lost
+		if(not resumed){
+
+			H[LEAVES].merge(H[NODES]);
+			H[LEAVES].add_lcp(0);//LCP[0]
+
+			cout << "Max LCP = " << H[LEAVES].max_lcp << ", max node depth = " << H[LEAVES].max_node_depth << endl;
+
+			H[LEAVES].save(stats);
+
+		}
+
+		stats.set("n", n);
+		stats.set("lcp_values", lcp_values);
 
 	}
 
 	/*
-	 * store LCP to file
+	 * store LCP to file using n_threads parallel writers (0 = number of hardware threads). Nothing to do if the
+	 * LCP has been built directly in lcp_path: the kernel writes back the remaining dirty pages, as for write().
+	 * If compress is true, the LCP is stored in compressed form (see compressed_lcp.hpp). With run sampling,
+	 * lcp_path contains the sampled values and lcp_path.pos their positions (8-Byte integers), in increasing order.
 	 */
-	void save_to_file(string lcp_path){
+	void save_to_file(string lcp_path, uint64_t n_threads = 0, bool compress = false){
+
+		stats.begin_phase("save");
+
+		uint64_t bytes = LCP.size() * sizeof(lcp_int_t);
+
+		if(run_sampled){
+
+			output_writer out(n_threads);
+
+			uint64_t r = SLCP.samples();
+			sampled_lcp<lcp_int_t> * S = &SLCP;
+
+			out.write_raw(lcp_path, SLCP.data(), r * sizeof(lcp_int_t));
+
+			out.write_formatted(lcp_path + ".pos", r, sizeof(uint64_t), [S](uint64_t begin, uint64_t end, char * buf){
+
+				S->positions(begin, end - begin, (uint64_t*)buf);
+
+			});
+
+			out.wait();
+
+			bytes = r * (sizeof(lcp_int_t) + sizeof(uint64_t));
+			stats.set("lcp_samples", r);
+
+		}else if(compress){
 
-		std::ofstream out(lcp_path);
+			output_writer out(n_threads);
 
-		out.write((char*)LCP.data(),LCP.size() * sizeof(lcp_int_t));
+			bytes = compressed_lcp::save(LCP.data(), LCP.size(), lcp_path, out);
+			stats.set("lcp_raw_bytes", LCP.size() * sizeof(lcp_int_t));
 
-		out.close();
+			out.wait();
+
+		}else if(lcp_path != lcp_file){
+
+			output_writer out(n_threads);
+
+			out.write_raw(lcp_path, LCP.data(), LCP.size() * sizeof(lcp_int_t));
+
+			out.wait();
+
+		}
+
+		stats.end_phase(n);
+		stats.set("bytes_written", bytes);
+
+		//the run is complete
+		if(ckpt.enabled()){
+
+			ckpt.remove();
+			if(lcp_file != lcp_path) std::remove(lcp_file.c_str());
+
+		}
 
 	}
 
-	vector<lcp_int_t> LCP;
+	/*
+	 * store the shortest unique substring lengths (one lcp_int_t per BWT position, see above) to sus_path using n_threads
+	 * parallel writers. Requires the full LCP (not run_sampled). With a depth cap K, values larger than K are stored as K+1.
+	 */
+	void save_sus(string sus_path, uint64_t n_threads = 0){
+
+		assert(not run_sampled);
+
+		cout << "Storing shortest unique substring lengths to " << sus_path << " ... " << endl;
+
+		stats.begin_phase("sus");
+
+		const lcp_int_t * L = LCP.data();
+		uint64_t size = n;
+
+		output_writer out(n_threads);
+
+		out.write_formatted(sus_path, n, sizeof(lcp_int_t), [L, size](uint64_t begin, uint64_t end, char * buf){
+
+			lcp_int_t * S = (lcp_int_t*)buf;
+
+			for(uint64_t i = begin; i < end; ++i)
+				S[i-begin] = 1 + std::max(L[i], i+1 < size ? L[i+1] : lcp_int_t(0));
+
+		});
+
+		out.wait();
+
+		stats.end_phase(n);
+		stats.set("sus_bytes_written", n*sizeof(lcp_int_t));
+
+	}
+
+	/*
+	 * traversal callbacks (see st_traversal.hpp)
+	 */
+
+	/*
+	 * all suffixes in leaf L share a prefix of length L.depth: fill the LCP inside L
+	 */
+	inline bool on_leaf(sa_leaf & L){
+
+		assert(L.rn.second > L.rn.first);
+
+		H[LEAVES].add_leaf(L.rn.second - L.rn.first);
+		H[LEAVES].add_lcp(L.depth, L.rn.second - L.rn.first - 1);
+
+		if(run_sampled){
+
+			SLCP.fill(L.rn.first+1, L.rn.second, L.depth);
+
+			lcp_values += L.rn.second - L.rn.first - 1;
+			m += L.rn.second - L.rn.first;
+
+			return L.depth+1 < K;
+
+		}
+
+		for(uint64_t i = L.rn.first+1; i<L.rn.second; ++i){
+
+			//after a resume, the value may have been computed after the checkpoint
+			assert(LCP[i]==nil or resumed);
+
+			lcp_values += LCP[i]==nil;
+
+			LCP[i] = L.depth;
+
+			m++;
+
+		}
+
+		m++;
+
+		assert(m<=n);
+
+		//children have depth L.depth+1: their LCP values are at least K
+		return L.depth+1 < K;
+
+	}
+
+	/*
+	 * fill the LCP at the borders of N's children
+	 */
+	inline bool on_node(typename bwt_t::sa_node_t & N){
+
+		uint64_t filled = lcp_values;
+
+		if(run_sampled) update_lcp<lcp_int_t>(N,SLCP,lcp_values);
+		else update_lcp<lcp_int_t>(N,LCP,lcp_values,resumed);
+
+		H[NODES].add_lcp(N.depth, lcp_values - filled);
+		H[NODES].add_node(node_size(N), N.depth);
+
+		if(find_repeats) add_repeats(N);
+
+		return N.depth+1 < K;
+
+	}
+
+	void on_sample(uint64_t leaves, uint64_t max_stack, stack<sa_leaf> & S){
+
+		P->update(leaves, S.size(), lcp_values);
+
+		if(ckpt.due()) save_checkpoint(LEAVES, {leaves, max_stack, m}, S);
+
+		LCP.flush_async();
+
+	}
+
+	void on_sample(uint64_t nodes, uint64_t max_stack, stack<typename bwt_t::sa_node_t> & S){
+
+		P->update(nodes, S.size(), lcp_values);
+
+		if(ckpt.due()) save_checkpoint(NODES, {nodes, max_stack}, S);
+
+		LCP.flush_async();
+
+	}
+
+	mmap_array<lcp_int_t> LCP;
+	sampled_lcp<lcp_int_t> SLCP;//with run sampling, instead of LCP
+
+	run_stats stats;//time spent in each phase, counters
 
 private:
 
+	enum {LEAVES, NODES};//traversal phases
+
+	/*
+	 * flush the LCP to disk, then save the traversal state
+	 */
+	template<class T>
+	void save_checkpoint(uint64_t phase, vector<uint64_t> counters, stack<T> & S){
+
+		LCP.sync();
+		ckpt.save(phase, counters, S);
+
+	}
+
+	/*
+	 * stream N, if it is a maximal repeat, and the maximal terminal strings reached from N
+	 */
+	void add_repeats(typename bwt_t::sa_node_t & N){
+
+		if(N.depth >= min_repeat and left_maximal(N)){
+
+			uint64_t rec[REP_LCP_RECORD_WORDS] = {N.depth, node_size(N), N.first_TERM};
+			REP.add(rec);
+
+		}
+
+		range_t node(N.first_TERM, N.last);
+		range_t term = child_TERM(N);
+
+		TS.visit(&node, &term, N.depth, [&](uint64_t depth, range_t * r){
+
+			uint64_t rec[REP_LCP_RECORD_WORDS] = {depth, range_length(r[0]), r[0].first};
+			REP.add(rec);
+
+		});
+
+	}
+
+	/*
+	 * true iff the occurrences of N are preceded by at least two distinct characters (each terminator being distinct)
+	 */
+	bool left_maximal(sa_node & N){
+
+		uint64_t c[5];
+		letter_counts(bwt->LF(range_t(N.first_TERM, N.last)), node_size(N), c);
+
+		return ::left_maximal(c, 5, node_size(N));
+
+	}
+
+	bool left_maximal(sa_node_n & N){
+
+		uint64_t c[6];
+		letter_counts(bwt->LF(range_t(N.first_TERM, N.last)), node_size(N), c);
+
+		return ::left_maximal(c, 6, node_size(N));
+
+	}
+
+	checkpoint ckpt;//disabled if no checkpoint path is given
+	string lcp_file;//file backing the LCP (empty if the LCP is in anonymous memory)
+
+	bool resumed = false;//the run was resumed from a checkpoint
+	bool run_sampled = false;//only the run boundaries are stored (in SLCP)
+
+	bool find_repeats = false;//stream the maximal repeats to REP
+	uint64_t min_repeat = 1;//minimum length of a reported repeat
+	repeat_writer REP;
+	terminal_strings<bwt_t, 1> TS;//maximal repeats followed only by terminators
+
 	uint64_t n = 0;//total size
 
+	uint64_t m = 0;//portion of text covered by visited leaves
+	uint64_t lcp_values = 1;//number of filled LCP values
+	uint64_t K = 0;//depth cap, or nil if there is no cap
+
+	unique_ptr<progress> P;//progress of the running phase
+
+	lcp_stats H[2];//repeat structure, per phase
+
 	bwt_t * bwt = NULL;
 
 	lcp_int_t nil = ~lcp_int_t(0);
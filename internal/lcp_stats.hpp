@@ -0,0 +1,147 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * lcp_stats.hpp
+ *
+ *  Created on: Jan 28, 2019
+ *      Author: nico
+ *
+ *  Repeat structure of a collection, collected while the LCP is computed (bwt2lcp, merge_bwt) instead of with a
+ *  pass over the output file:
+ *
+ *  	- LCP histogram: number of positions for each LCP value (with a depth cap K, value K counts the LCPs >= K),
+ *  	  and the largest LCP value;
+ *  	- node sizes: number of visited suffix-tree nodes with size (number of suffixes) in [2^b, 2^(b+1)), for each b,
+ *  	  and the depth of the deepest one;
+ *  	- leaf sizes: the same, for the visited suffix-tree leaves.
+ *
+ *  Each traversal (or thread) fills its own lcp_stats, and these are merged at the end. The report is stored in the
+ *  run statistics as arrays of [value, count] pairs (non-zero counts only).
+ *
+ */
+
+#ifndef INTERNAL_LCP_STATS_HPP_
+#define INTERNAL_LCP_STATS_HPP_
+
+#define LCP_STATS_DENSE 4096 //LCP values below this are histogrammed in an array, the others in a map
+#define LCP_STATS_BUCKETS 64
+
+#include "stats.hpp"
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+class lcp_stats{
+
+public:
+
+	lcp_stats() : dense(LCP_STATS_DENSE, 0), nodes(LCP_STATS_BUCKETS, 0), leaves(LCP_STATS_BUCKETS, 0) {}
+
+	/*
+	 * count positions with LCP value v
+	 */
+	inline void add_lcp(uint64_t v, uint64_t positions = 1){
+
+		if(positions == 0) return;
+
+		if(v < LCP_STATS_DENSE) dense[v] += positions;
+		else sparse[v] += positions;
+
+		max_lcp = std::max(max_lcp, v);
+
+	}
+
+	/*
+	 * count a visited node of the given size (number of suffixes) and depth
+	 */
+	inline void add_node(uint64_t size, uint64_t depth){
+
+		nodes[bucket(size)]++;
+		max_node_depth = std::max(max_node_depth, depth);
+
+	}
+
+	inline void add_leaf(uint64_t size){
+
+		leaves[bucket(size)]++;
+
+	}
+
+	/*
+	 * add the counters of other to these
+	 */
+	void merge(lcp_stats & other){
+
+		for(uint64_t v = 0; v < LCP_STATS_DENSE; ++v) dense[v] += other.dense[v];
+		for(auto & e : other.sparse) sparse[e.first] += e.second;
+
+		for(uint64_t b = 0; b < LCP_STATS_BUCKETS; ++b){
+
+			nodes[b] += other.nodes[b];
+			leaves[b] += other.leaves[b];
+
+		}
+
+		max_lcp = std::max(max_lcp, other.max_lcp);
+		max_node_depth = std::max(max_node_depth, other.max_node_depth);
+
+	}
+
+	/*
+	 * store the report in stats. If lcp is false, the LCP histogram is omitted (the LCP was not computed).
+	 */
+	void save(run_stats & stats, bool lcp = true){
+
+		if(lcp){
+
+			vector<pair<uint64_t, uint64_t> > H;
+
+			for(uint64_t v = 0; v < LCP_STATS_DENSE; ++v) if(dense[v] > 0) H.push_back({v, dense[v]});
+			for(auto & e : sparse) H.push_back(e);
+
+			stats.set("max_lcp", max_lcp);
+			stats.set("lcp_histogram", H);
+
+		}
+
+		stats.set("max_node_depth", max_node_depth);
+		stats.set("node_size_log2_histogram", buckets(nodes));
+		stats.set("leaf_size_log2_histogram", buckets(leaves));
+
+	}
+
+	uint64_t max_lcp = 0;
+	uint64_t max_node_depth = 0;
+
+private:
+
+	//floor(log2(size)), size > 0
+	static inline uint64_t bucket(uint64_t size){
+
+		return 63 - __builtin_clzll(size | 1);
+
+	}
+
+	static vector<pair<uint64_t, uint64_t> > buckets(vector<uint64_t> & B){
+
+		vector<pair<uint64_t, uint64_t> > H;
+
+		for(uint64_t b = 0; b < LCP_STATS_BUCKETS; ++b) if(B[b] > 0) H.push_back({b, B[b]});
+
+		return H;
+
+	}
+
+	vector<uint64_t> dense;
+	map<uint64_t, uint64_t> sparse;
+
+	vector<uint64_t> nodes;//visited nodes per size bucket
+	vector<uint64_t> leaves;//visited leaves per size bucket
+
+};
+
+#endif /* INTERNAL_LCP_STATS_HPP_ */
@@ -0,0 +1,356 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * mmap_array.hpp
+ *
+ *  Created on: Jan 18, 2019
+ *      Author: nico
+ *
+ *  Fixed-size arrays stored in memory mappings.
+ *
+ *  - mmap_array<T>: array of n elements of type T, either in anonymous memory (behaves like a vector) or backed
+ *    by a file (MAP_SHARED): sync() flushes it to disk, and the content survives the process. Used for the LCP
+ *    and DA of long runs, so that a checkpoint can be taken without copying them, and to map the output LCP file
+ *    directly (no final copy; the kernel can page the array out under memory pressure).
+ *  - bit_array: array of n bits packed in 64-bit words of a mmap_array<uint64_t> (e.g. the document array).
+ *
+ */
+
+#ifndef INTERNAL_MMAP_ARRAY_HPP_
+#define INTERNAL_MMAP_ARRAY_HPP_
+
+#define MMAP_FLUSH_SECONDS 5 //min interval between two asynchronous writebacks of a file-backed array
+
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cassert>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+template<typename T>
+class mmap_array{
+
+public:
+
+	mmap_array(){}
+
+	/*
+	 * n elements in anonymous memory, initialized to init
+	 */
+	mmap_array(uint64_t n, T init = T()){
+
+		this->n = n;
+
+		if(n == 0) return;
+
+		void * p = mmap(NULL, n*sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if(p == MAP_FAILED){
+
+			cout << "Error: cannot allocate " << n*sizeof(T) << " Bytes" << endl;
+			exit(1);
+
+		}
+
+		a = (T*)p;
+
+		//anonymous pages are already zero
+		if(init != T()) std::fill(a, a+n, init);
+
+	}
+
+	/*
+	 * n elements stored in file path. If keep is false, the file is (re)created, its blocks are allocated (so that
+	 * running out of disk space is detected now, not as a fault while writing) and the elements are initialized
+	 * to init; otherwise, the current content of the file (which must contain exactly n elements) is used.
+	 */
+	mmap_array(string path, uint64_t n, T init, bool keep){
+
+		this->n = n;
+
+		int fd = open(path.c_str(), keep ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+		if(fd < 0){
+
+			cout << "Error: cannot open file " << path << endl;
+			exit(1);
+
+		}
+
+		struct stat st;
+		fstat(fd, &st);
+
+		if(keep and uint64_t(st.st_size) != n*sizeof(T)){
+
+			cout << "Error: file " << path << " has size " << st.st_size << ", expected " << n*sizeof(T) << " Bytes" << endl;
+			exit(1);
+
+		}
+
+		if(not keep and ftruncate(fd, n*sizeof(T)) != 0){
+
+			cout << "Error: cannot resize file " << path << " to " << n*sizeof(T) << " Bytes" << endl;
+			exit(1);
+
+		}
+
+		//not all file systems support fallocate: in that case, blocks are allocated while writing
+		if(not keep and n > 0 and fallocate(fd, 0, 0, n*sizeof(T)) != 0 and errno != EOPNOTSUPP){
+
+			cout << "Error: cannot allocate " << n*sizeof(T) << " Bytes for file " << path << endl;
+			exit(1);
+
+		}
+
+		if(n > 0){
+
+			void * p = mmap(NULL, n*sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+			if(p == MAP_FAILED){
+
+				cout << "Error: cannot map file " << path << endl;
+				exit(1);
+
+			}
+
+			a = (T*)p;
+			shared = true;
+
+		}
+
+		this->fd = fd;//kept open for flush_async
+
+		//ftruncate fills the file with zeros
+		if(not keep and init != T()) std::fill(a, a+n, init);
+
+	}
+
+	mmap_array(const mmap_array &) = delete;
+	mmap_array & operator=(const mmap_array &) = delete;
+
+	mmap_array(mmap_array && other){
+
+		*this = std::move(other);
+
+	}
+
+	mmap_array & operator=(mmap_array && other){
+
+		if(this == &other) return *this;
+
+		release();
+
+		a = other.a;
+		n = other.n;
+		shared = other.shared;
+		fd = other.fd;
+		last_flush = other.last_flush;
+
+		other.a = NULL;
+		other.n = 0;
+		other.shared = false;
+		other.fd = -1;
+
+		return *this;
+
+	}
+
+	~mmap_array(){
+
+		release();
+
+	}
+
+	inline T & operator[](uint64_t i){
+
+		assert(i<n);
+		return a[i];
+
+	}
+
+	uint64_t size(){
+		return n;
+	}
+
+	T * data(){
+		return a;
+	}
+
+	/*
+	 * if the array is backed by a file, write all modified pages to disk and wait for completion
+	 */
+	void sync(){
+
+		if(shared and msync(a, n*sizeof(T), MS_SYNC) != 0){
+
+			cout << "Error: msync failed" << endl;
+			exit(1);
+
+		}
+
+	}
+
+	/*
+	 * if the array is backed by a file, start writing its dirty pages to disk without waiting. Cheap to call
+	 * often: does nothing if less than MMAP_FLUSH_SECONDS seconds have passed since the previous writeback.
+	 * Keeps the amount of dirty pages bounded, so that the kernel can reclaim them under memory pressure and
+	 * the data is (almost) on disk when the run ends.
+	 */
+	void flush_async(){
+
+		if(not shared) return;
+
+		auto now = chrono::steady_clock::now();
+
+		if(now - last_flush < chrono::seconds(MMAP_FLUSH_SECONDS)) return;
+
+		sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+
+		last_flush = now;
+
+	}
+
+private:
+
+	void release(){
+
+		if(a != NULL) munmap(a, n*sizeof(T));
+		if(fd >= 0) close(fd);
+
+		a = NULL;
+		n = 0;
+		shared = false;
+		fd = -1;
+
+	}
+
+	T * a = NULL;
+	uint64_t n = 0;
+
+	bool shared = false;//backed by a file
+	int fd = -1;//file descriptor of the backing file
+
+	chrono::steady_clock::time_point last_flush = chrono::steady_clock::now();
+
+};
+
+class bit_array{
+
+public:
+
+	bit_array(){}
+
+	/*
+	 * n bits in anonymous memory, all 0
+	 */
+	bit_array(uint64_t n) : words(n/64 + (n%64 != 0)), n(n) {}
+
+	/*
+	 * n bits stored in file path (see mmap_array). If keep is false, the bits are all 0.
+	 */
+	bit_array(string path, uint64_t n, bool keep) : words(path, n/64 + (n%64 != 0), 0, keep), n(n) {}
+
+	inline bool operator[](uint64_t i){
+
+		assert(i<n);
+		return (words[i/64] >> (i%64)) & 1;
+
+	}
+
+	/*
+	 * set bits in [begin, end) to b
+	 */
+	void set_range(uint64_t begin, uint64_t end, bool b){
+
+		assert(begin <= end and end <= n);
+
+		while(begin < end and begin%64 != 0) set(begin++, b);
+
+		for(; begin + 64 <= end; begin += 64) words[begin/64] = b ? ~uint64_t(0) : 0;
+
+		while(begin < end) set(begin++, b);
+
+	}
+
+	/*
+	 * number of 1s in [begin, end)
+	 */
+	uint64_t count_ones(uint64_t begin, uint64_t end){
+
+		assert(begin <= end and end <= n);
+
+		uint64_t ones = 0;
+
+		while(begin < end and begin%64 != 0) ones += (*this)[begin++];
+
+		for(; begin + 64 <= end; begin += 64) ones += __builtin_popcountll(words[begin/64]);
+
+		while(begin < end) ones += (*this)[begin++];
+
+		return ones;
+
+	}
+
+	/*
+	 * end (excluded) of the run of equal bits containing position i: the first j > i with bit j != bit i, or n.
+	 * Scans 64 bits at a time.
+	 */
+	uint64_t run_end(uint64_t i){
+
+		assert(i<n);
+
+		uint64_t flip = (*this)[i] ? ~uint64_t(0) : 0;//complement the bits if the run is of 1s
+
+		uint64_t w = i/64;
+		uint64_t x = (words[w] ^ flip) & (~uint64_t(0) << (i%64));
+
+		while(x == 0 and ++w < words.size()) x = words[w] ^ flip;
+
+		return x == 0 ? n : std::min(n, w*64 + __builtin_ctzll(x));
+
+	}
+
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * the packed bits: bit i is bit i%64 of word i/64
+	 */
+	uint64_t * data(){
+		return words.data();
+	}
+
+	uint64_t n_words(){
+		return words.size();
+	}
+
+	void sync(){
+		words.sync();
+	}
+
+private:
+
+	inline void set(uint64_t i, bool b){
+
+		uint64_t mask = uint64_t(1) << (i%64);
+		words[i/64] = b ? words[i/64] | mask : words[i/64] & ~mask;
+
+	}
+
+	mmap_array<uint64_t> words;
+	uint64_t n = 0;
+
+};
+
+#endif /* INTERNAL_MMAP_ARRAY_HPP_ */
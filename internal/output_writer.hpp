@@ -0,0 +1,258 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * output_writer.hpp
+ *
+ *  Created on: Dec 12, 2018
+ *      Author: nico
+ *
+ *  Asynchronous, parallel output writer. Output files are split in chunks of OUT_CHUNK_SIZE Bytes;
+ *  a pool of worker threads formats the chunks (e.g. decodes the merged BWT) and writes them with
+ *  large aligned pwrite calls at their final offset. Since chunks are independent, formatting and I/O of
+ *  different chunks (and different files) overlap.
+ *
+ *  Usage: submit any number of files with write_raw / write_formatted / write_parts, then call wait().
+ *
+ */
+
+#ifndef INTERNAL_OUTPUT_WRITER_HPP_
+#define INTERNAL_OUTPUT_WRITER_HPP_
+
+#define OUT_CHUNK_SIZE 0x1000000 	//Bytes per output chunk = 16 MiB (multiple of the page size)
+
+#include "include.hpp"
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+class output_writer{
+
+public:
+
+	/*
+	 * n_threads = number of worker threads. If 0, use the number of hardware threads.
+	 */
+	output_writer(uint64_t n_threads = 0){
+
+		if(n_threads == 0) n_threads = thread::hardware_concurrency();
+		if(n_threads == 0) n_threads = 1;
+
+		for(uint64_t i=0;i<n_threads;++i) workers.push_back(thread(&output_writer::work, this));
+
+	}
+
+	~output_writer(){
+
+		wait();
+
+		{
+			unique_lock<mutex> lock(mtx);
+			stop = true;
+		}
+
+		has_task.notify_all();
+
+		for(auto & w : workers) w.join();
+
+	}
+
+	/*
+	 * asynchronously write bytes [data, data+size) to file path. The memory must stay valid until wait() returns.
+	 */
+	void write_raw(string path, const void * data, uint64_t size){
+
+		int fd = open_output(path, size);
+
+		for(uint64_t off = 0; off < size; off += OUT_CHUNK_SIZE){
+
+			uint64_t len = std::min<uint64_t>(OUT_CHUNK_SIZE, size - off);
+
+			submit([=](){ write_at(fd, (const char*)data + off, len, off); });
+
+		}
+
+	}
+
+	/*
+	 * asynchronously write a file of n_items items of item_size Bytes each. Chunks are formatted in parallel by calling
+	 * format(begin, end, buf), which must store items [begin, end) in buf. format is called concurrently from several threads.
+	 */
+	void write_formatted(string path, uint64_t n_items, uint64_t item_size, function<void(uint64_t, uint64_t, char*)> format){
+
+		int fd = open_output(path, n_items * item_size);
+
+		uint64_t items_per_chunk = std::max<uint64_t>(1, OUT_CHUNK_SIZE / item_size);
+
+		for(uint64_t begin = 0; begin < n_items; begin += items_per_chunk){
+
+			uint64_t end = std::min<uint64_t>(n_items, begin + items_per_chunk);
+
+			submit([=](){
+
+				vector<char> buf((end - begin) * item_size);
+				format(begin, end, buf.data());
+				write_at(fd, buf.data(), buf.size(), begin * item_size);
+
+			});
+
+		}
+
+	}
+
+	/*
+	 * asynchronously write a file made of parts of variable size: part k occupies Bytes [offsets[k], offsets[k+1]) and is
+	 * produced by format(k, buf), which must fill buf with its offsets[k+1]-offsets[k] Bytes. format is called concurrently
+	 * from several threads.
+	 */
+	void write_parts(string path, vector<uint64_t> offsets, function<void(uint64_t, char*)> format){
+
+		assert(offsets.size() > 0);
+
+		int fd = open_output(path, offsets.back());
+
+		for(uint64_t k = 0; k+1 < offsets.size(); ++k){
+
+			uint64_t off = offsets[k];
+			uint64_t len = offsets[k+1] - offsets[k];
+
+			submit([=](){
+
+				vector<char> buf(len);
+				format(k, buf.data());
+				write_at(fd, buf.data(), len, off);
+
+			});
+
+		}
+
+	}
+
+	/*
+	 * run task on one of the worker threads
+	 */
+	void submit(function<void()> task){
+
+		{
+			unique_lock<mutex> lock(mtx);
+			tasks.push(task);
+			pending++;
+		}
+
+		has_task.notify_one();
+
+	}
+
+	/*
+	 * block until all submitted tasks are completed, then close all files opened so far.
+	 */
+	void wait(){
+
+		{
+			unique_lock<mutex> lock(mtx);
+			all_done.wait(lock, [this](){ return pending == 0; });
+		}
+
+		for(auto fd : fds) close(fd);
+		fds.clear();
+
+	}
+
+	uint64_t number_of_threads(){
+		return workers.size();
+	}
+
+private:
+
+	void work(){
+
+		while(true){
+
+			function<void()> task;
+
+			{
+				unique_lock<mutex> lock(mtx);
+				has_task.wait(lock, [this](){ return stop or not tasks.empty(); });
+
+				if(tasks.empty()) return;
+
+				task = tasks.front();
+				tasks.pop();
+			}
+
+			task();
+
+			{
+				unique_lock<mutex> lock(mtx);
+				pending--;
+				if(pending == 0) all_done.notify_all();
+			}
+
+		}
+
+	}
+
+	/*
+	 * create (truncate) file and pre-size it to size Bytes
+	 */
+	int open_output(string path, uint64_t size){
+
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if(fd < 0 or ftruncate(fd, size) != 0){
+
+			cout << "Error: cannot create output file " << path << endl;
+			exit(1);
+
+		}
+
+		fds.push_back(fd);
+
+		return fd;
+
+	}
+
+	static void write_at(int fd, const char * buf, uint64_t len, uint64_t off){
+
+		while(len > 0){
+
+			ssize_t w = pwrite(fd, buf, len, off);
+
+			if(w <= 0){
+
+				cout << "Error while writing output file" << endl;
+				exit(1);
+
+			}
+
+			buf += w;
+			off += w;
+			len -= w;
+
+		}
+
+	}
+
+	vector<thread> workers;
+	vector<int> fds;
+
+	queue<function<void()> > tasks;
+	uint64_t pending = 0; //submitted and not yet completed tasks
+
+	mutex mtx;
+	condition_variable has_task;
+	condition_variable all_done;
+
+	bool stop = false;
+
+};
+
+#endif /* INTERNAL_OUTPUT_WRITER_HPP_ */
@@ -0,0 +1,569 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * overlap_graph.hpp
+ *
+ *  Created on: Jan 26, 2019
+ *      Author: nico
+ *
+ *  All-pairs suffix-prefix overlaps of a read collection, from its eBWT (as in string graph assembly).
+ *
+ *  Reads are identified by the position of their terminator suffix in the eBWT: read k is the one whose row
+ *  TERM is the k-th (equal suffixes are sorted by read index, so this is the index of the read in the collection).
+ *  For each pair of distinct reads i, j we output the longest l >= tau such that the suffix of length l of read i
+ *  is a prefix of read j, if any. Containments are not reported (l < |read i| and l < |read j|).
+ *
+ *  Read i is spelled backwards by LF-mapping from its row TERM, while extending two ranges by the same characters:
+ *  the range of W (suffix of read i of length l) and the range of W.TERM. The reads having prefix W are the rows
+ *  TERM.W, i.e. the TERM-ranks of range(W), which form a contiguous range of reads in lexicographic order; those
+ *  equal to W (rows TERM.W.TERM, the TERM-ranks of range(W.TERM)) come first and are skipped. A permutation computed
+ *  by a first pass (8 Bytes per read) maps lexicographic ranks to read indices. No LCP is computed, and reads are
+ *  processed in parallel.
+ *
+ *  Output file: a header of 64-bit little-endian words
+ *
+ *  	[0]          magic "DOVL", then version (1 Byte), then 3 Bytes = 0
+ *  	[1]          number of reads
+ *  	[2]          tau
+ *  	[3]          number of edges
+ *
+ *  followed by one group for each read i with at least one edge, in increasing order of i: varint(i - i'), where i' is
+ *  the previous such read plus 1 (0 for the first group), varint(number of edges e), then e edges in increasing order
+ *  of j: varint(j - j') (j' = previous j plus 1, 0 for the first edge of the group) and varint(l - tau). Varints are
+ *  LEB128 (7 bits per Byte, least significant first). Class overlap_reader streams the edges back.
+ *
+ */
+
+#ifndef INTERNAL_OVERLAP_GRAPH_HPP_
+#define INTERNAL_OVERLAP_GRAPH_HPP_
+
+#define OVL_MAGIC "DOVL"
+#define OVL_VERSION 1
+#define OVL_HEADER_WORDS 4
+#define OVL_CHUNK 4096 //reads per task
+
+#include "include.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+/*
+ * sum of the first (second) extremes of the ranges of all letters
+ */
+inline uint64_t sum_first(const p_range & r){
+	return r.A.first + r.C.first + r.G.first + r.T.first;
+}
+inline uint64_t sum_first(const p_range_n & r){
+	return r.A.first + r.C.first + r.G.first + r.N.first + r.T.first;
+}
+inline uint64_t sum_second(const p_range & r){
+	return r.A.second + r.C.second + r.G.second + r.T.second;
+}
+inline uint64_t sum_second(const p_range_n & r){
+	return r.A.second + r.C.second + r.G.second + r.N.second + r.T.second;
+}
+
+/*
+ * range of letter c
+ */
+inline range_t letter_range(const p_range & r, char c){
+
+	switch(c){
+		case 'A': return r.A;
+		case 'C': return r.C;
+		case 'G': return r.G;
+		default: return r.T;
+	}
+
+}
+inline range_t letter_range(const p_range_n & r, char c){
+
+	switch(c){
+		case 'A': return r.A;
+		case 'C': return r.C;
+		case 'G': return r.G;
+		case 'N': return r.N;
+		default: return r.T;
+	}
+
+}
+
+inline void put_varint(vector<uint8_t> & out, uint64_t x){
+
+	while(x >= 0x80){
+
+		out.push_back(uint8_t(x) | 0x80);
+		x >>= 7;
+
+	}
+
+	out.push_back(uint8_t(x));
+
+}
+
+template<class bwt_t>
+class overlap_graph{
+
+public:
+
+	/*
+	 * compute the overlaps of length >= tau (tau >= 1) of the reads in bwt and stream them to file path, using n_threads
+	 * threads (0 = number of hardware threads)
+	 */
+	overlap_graph(bwt_t * bwt, uint64_t tau, string path, uint64_t n_threads = 0){
+
+		assert(tau > 0);
+
+		this->bwt = bwt;
+		this->tau = tau;
+
+		n = bwt->size();
+		TERM = bwt->terminator();
+
+		F = bwt->LF(range_t(0,0));
+		R = F.A.first;
+
+		if(n_threads == 0) n_threads = std::max<uint64_t>(1, thread::hardware_concurrency());
+
+		cout << "Number of reads: " << R << endl;
+
+		/*
+		 * FIRST PASS: LEXICOGRAPHIC RANK -> READ INDEX
+		 */
+
+		cout << "\nSpelling reads to sort them lexicographically." << endl;
+
+		stats.begin_phase("reads");
+
+		read_of_rank = vector<uint64_t>(R);
+
+		{
+
+			progress P("reads", R, {"reads"});
+
+			parallel(n_threads, P, [this](uint64_t first, uint64_t last, vector<uint8_t> &, uint64_t &, uint64_t &, uint64_t &){
+
+				for(uint64_t k = first; k < last; ++k){
+
+					uint64_t p = k;
+					char c;
+
+					while((c = (*this->bwt)[p]) != TERM) p = LF(p, c);
+
+					read_of_rank[this->bwt->rank(p, TERM)] = k;
+
+				}
+
+			}, [](uint64_t, vector<uint8_t> &, uint64_t, uint64_t){});
+
+			P.stop();
+
+		}
+
+		stats.end_phase(R);
+
+		/*
+		 * SECOND PASS: OVERLAPS
+		 */
+
+		cout << "\nComputing suffix-prefix overlaps of length >= " << tau << "." << endl;
+
+		stats.begin_phase("overlaps");
+
+		ofstream out(path, ios::binary);
+
+		if(not out.good()){
+
+			cout << "Error: cannot open output file " << path << endl;
+			exit(1);
+
+		}
+
+		uint64_t header[OVL_HEADER_WORDS] = {0, R, tau, 0};
+		write_header(out, header);
+
+		uint64_t next_i = 0;//previous read with edges, plus 1
+
+		{
+
+			progress P("overlaps", R, {"reads"});
+
+			parallel(n_threads, P, [this](uint64_t first, uint64_t last, vector<uint8_t> & buf, uint64_t & first_i, uint64_t & last_i, uint64_t & edges){
+
+				vector<entry> E;
+				vector<pair<uint64_t, uint64_t> > out_edges;
+
+				first_i = last;
+
+				for(uint64_t i = first; i < last; ++i){
+
+					overlaps(i, E, out_edges);
+
+					if(out_edges.size() == 0) continue;
+
+					if(first_i == last) first_i = i;
+					else put_varint(buf, i - (last_i + 1));
+
+					put_varint(buf, out_edges.size());
+
+					uint64_t next_j = 0;
+
+					for(auto & e : out_edges){
+
+						put_varint(buf, e.first - next_j);
+						put_varint(buf, e.second - this->tau);
+						next_j = e.first + 1;
+
+					}
+
+					last_i = i;
+					edges += out_edges.size();
+
+				}
+
+			}, [&](uint64_t first_i, vector<uint8_t> & buf, uint64_t last_i, uint64_t edges){
+
+				if(edges == 0) return;
+
+				vector<uint8_t> gap;
+				put_varint(gap, first_i - next_i);
+
+				out.write((char*)gap.data(), gap.size());
+				out.write((char*)buf.data(), buf.size());
+
+				next_i = last_i + 1;
+				n_edges += edges;
+				bytes += gap.size() + buf.size();
+
+			});
+
+			P.stop();
+
+		}
+
+		header[3] = n_edges;
+
+		out.seekp(0);
+		write_header(out, header);
+		out.close();
+
+		bytes += OVL_HEADER_WORDS*sizeof(uint64_t);
+
+		stats.end_phase(R);
+
+		cout << "Found " << n_edges << " overlaps." << endl;
+
+		stats.set("reads", R);
+		stats.set("tau", tau);
+		stats.set("edges", n_edges);
+		stats.set("bytes_written", bytes);
+
+	}
+
+	uint64_t number_of_edges(){
+		return n_edges;
+	}
+
+	run_stats stats;
+
+private:
+
+	//overlaps of length l with the reads of lexicographic ranks [a, b)
+	struct entry{
+
+		uint64_t l;
+		uint64_t a;
+		uint64_t b;
+
+	};
+
+	/*
+	 * row of the LF-mapping of row p, whose BWT character is c != TERM
+	 */
+	inline uint64_t LF(uint64_t p, char c){
+
+		return letter_range(F, c).first + bwt->rank(p, c);
+
+	}
+
+	/*
+	 * out = maximal overlaps (j, l) of read i, in increasing order of j. E is a buffer.
+	 */
+	void overlaps(uint64_t i, vector<entry> & E, vector<pair<uint64_t, uint64_t> > & out){
+
+		E.clear();
+		out.clear();
+
+		range_t W = {0, n};//range of W
+		range_t WT = {0, R};//range of W.TERM
+		uint64_t p = i;//row of read i in range(W.TERM)
+		uint64_t l = 0;//|W|
+
+		uint64_t Fsum = sum_first(F);
+
+		char c;
+
+		while((c = (*bwt)[p]) != TERM){
+
+			auto LW = bwt->LF(W);
+			auto LWT = bwt->LF(WT);
+
+			//W is a proper suffix of read i
+			if(l >= tau){
+
+				uint64_t equal = (WT.second - WT.first) - (sum_second(LWT) - sum_first(LWT));//reads equal to W
+
+				uint64_t a = W.first - (sum_first(LW) - Fsum) + equal;
+				uint64_t b = W.second - (sum_second(LW) - Fsum);
+
+				if(a < b) E.push_back({l, a, b});
+
+			}
+
+			W = letter_range(LW, c);
+			WT = letter_range(LWT, c);
+			p = LF(p, c);
+			++l;
+
+		}
+
+		//longest overlaps first: each read j is reported with the first (longest) range containing it
+		map<uint64_t, uint64_t> covered;//disjoint ranges of lexicographic ranks already reported
+
+		for(auto e = E.rbegin(); e != E.rend(); ++e){
+
+			uint64_t a = e->a;
+			uint64_t b = e->b;
+
+			auto it = covered.upper_bound(a);
+			if(it != covered.begin() and std::prev(it)->second >= a) --it;
+
+			uint64_t x = a;
+
+			//emit the gaps of [a, b) between covered ranges, then merge [a, b) with them
+			while(it != covered.end() and it->first <= b){
+
+				for(; x < it->first; ++x) emit(i, x, e->l, out);
+
+				x = std::max(x, it->second);
+				a = std::min(a, it->first);
+				b = std::max(b, it->second);
+
+				it = covered.erase(it);
+
+			}
+
+			for(; x < b; ++x) emit(i, x, e->l, out);
+
+			covered[a] = b;
+
+		}
+
+		std::sort(out.begin(), out.end());
+
+	}
+
+	inline void emit(uint64_t i, uint64_t rank, uint64_t l, vector<pair<uint64_t, uint64_t> > & out){
+
+		uint64_t j = read_of_rank[rank];
+
+		if(j != i) out.push_back({j, l});
+
+	}
+
+	/*
+	 * run task(first, last, buf, first_i, last_i, edges) on chunks of OVL_CHUNK reads with n_threads threads, then
+	 * consume(first_i, buf, last_i, edges) on the results in chunk order
+	 */
+	template<class task_t, class consume_t>
+	void parallel(uint64_t n_threads, progress & P, task_t task, consume_t consume){
+
+		uint64_t n_chunks = R/OVL_CHUNK + (R%OVL_CHUNK != 0);
+		uint64_t round = 4*n_threads;//chunks per round
+
+		vector<vector<uint8_t> > buf(round);
+		vector<uint64_t> first_i(round), last_i(round), edges(round);
+
+		for(uint64_t begin = 0; begin < n_chunks; begin += round){
+
+			uint64_t end = std::min(n_chunks, begin + round);
+
+			atomic<uint64_t> next(begin);
+			vector<thread> T;
+
+			for(uint64_t t = 0; t < n_threads; ++t){
+
+				T.push_back(thread([&](){
+
+					uint64_t k;
+
+					while((k = next.fetch_add(1)) < end){
+
+						buf[k-begin].clear();
+						edges[k-begin] = 0;
+
+						task(k*OVL_CHUNK, std::min(R, (k+1)*OVL_CHUNK), buf[k-begin], first_i[k-begin], last_i[k-begin], edges[k-begin]);
+
+					}
+
+				}));
+
+			}
+
+			for(auto & t : T) t.join();
+
+			for(uint64_t k = begin; k < end; ++k) consume(first_i[k-begin], buf[k-begin], last_i[k-begin], edges[k-begin]);
+
+			P.update(std::min(R, end*OVL_CHUNK), 0, std::min(R, end*OVL_CHUNK));
+
+		}
+
+	}
+
+	static void write_header(ofstream & out, uint64_t * header){
+
+		char * magic = (char*)header;
+		std::memcpy(magic, OVL_MAGIC, 4);
+		magic[4] = OVL_VERSION;
+
+		out.write((char*)header, OVL_HEADER_WORDS*sizeof(uint64_t));
+
+	}
+
+	bwt_t * bwt = NULL;
+
+	uint64_t n = 0;
+	uint64_t R = 0;//number of reads
+	uint64_t tau = 0;
+
+	char TERM = '#';
+
+	decltype(std::declval<bwt_t>().LF(range_t())) F;//F column: F.c.first = number of characters smaller than c
+
+	vector<uint64_t> read_of_rank;//read index of the read of lexicographic rank r
+
+	uint64_t n_edges = 0;
+	uint64_t bytes = 0;
+
+};
+
+/*
+ * streams the edges of a file written by overlap_graph
+ */
+class overlap_reader{
+
+public:
+
+	overlap_reader(string path) : in(path, ios::binary){
+
+		uint64_t header[OVL_HEADER_WORDS];
+
+		in.read((char*)header, sizeof(header));
+
+		if(not in.good() or std::memcmp(header, OVL_MAGIC, 4) != 0 or ((char*)header)[4] != OVL_VERSION){
+
+			cout << "Error: " << path << " is not an overlap file" << endl;
+			exit(1);
+
+		}
+
+		R = header[1];
+		tau = header[2];
+		n_edges = header[3];
+
+	}
+
+	uint64_t number_of_reads(){
+		return R;
+	}
+
+	uint64_t min_overlap(){
+		return tau;
+	}
+
+	uint64_t number_of_edges(){
+		return n_edges;
+	}
+
+	/*
+	 * next edge: the suffix of length l of read i is a prefix of read j. Returns false at the end of the file.
+	 */
+	bool next(uint64_t & i, uint64_t & j, uint64_t & l){
+
+		if(read_edges == n_edges) return false;
+
+		if(left == 0){
+
+			this->i = next_i + get_varint();
+			next_i = this->i + 1;
+
+			left = get_varint();
+			next_j = 0;
+
+		}
+
+		i = this->i;
+		j = next_j + get_varint();
+		l = tau + get_varint();
+
+		next_j = j + 1;
+
+		--left;
+		++read_edges;
+
+		return true;
+
+	}
+
+private:
+
+	uint64_t get_varint(){
+
+		uint64_t x = 0;
+
+		for(int s = 0; ; s += 7){
+
+			int b = in.get();
+
+			if(b == EOF){
+
+				cout << "Error: truncated overlap file" << endl;
+				exit(1);
+
+			}
+
+			x |= uint64_t(b & 0x7F) << s;
+
+			if((b & 0x80) == 0) return x;
+
+		}
+
+	}
+
+	ifstream in;
+
+	uint64_t R = 0;
+	uint64_t tau = 0;
+	uint64_t n_edges = 0;
+
+	uint64_t read_edges = 0;
+	uint64_t left = 0;//edges left in the current group
+
+	uint64_t i = 0;
+	uint64_t next_i = 0;
+	uint64_t next_j = 0;
+
+};
+
+#endif /* INTERNAL_OVERLAP_GRAPH_HPP_ */
@@ -0,0 +1,287 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * packed_da.hpp
+ *
+ *  Created on: Jan 21, 2019
+ *      Author: nico
+ *
+ *  Binary document array file (written by merge_bwt -D), with rank/select support. The file is a sequence of
+ *  64-bit little-endian words:
+ *
+ *  	[0]                  magic "DBDA", then version (1 Byte), then 3 Bytes = 0
+ *  	[1]                  n = number of bits (DA length)
+ *  	[2]                  number of 1s
+ *  	[3]                  n_super = number of entries of the rank directory
+ *  	[4, 4+n_words)       the bits: bit i is bit i%64 of word i/64. 0 = suffix of collection 1, 1 = collection 2
+ *  	[4+n_words, +n_super) rank directory: entry j = number of 1s in bits [0, j*DA_SUPERBLOCK)
+ *
+ *  with n_words = ceil(n/64). Consumers mmap the file (class packed_da) and answer rank queries in O(1) (one directory
+ *  access plus at most DA_SUPERBLOCK/64 popcounts) and select queries in O(log n), without any conversion.
+ *
+ */
+
+#ifndef INTERNAL_PACKED_DA_HPP_
+#define INTERNAL_PACKED_DA_HPP_
+
+#define DA_MAGIC "DBDA"
+#define DA_VERSION 1
+#define DA_HEADER_WORDS 4
+#define DA_SUPERBLOCK 512 //bits per rank directory entry
+
+#include "mmap_array.hpp"
+#include "output_writer.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+class packed_da{
+
+public:
+
+	/*
+	 * asynchronously write DA to path in the binary format (see above) using writer out. DA must stay valid
+	 * until out.wait() returns. Returns the file size in Bytes.
+	 */
+	static uint64_t save(bit_array & DA, string path, output_writer & out){
+
+		uint64_t n = DA.size();
+		uint64_t n_words = DA.n_words();
+		uint64_t words_per_super = DA_SUPERBLOCK/64;
+
+		//rank directory
+		auto dir = make_shared<vector<uint64_t> >(n_words/words_per_super + 1);
+
+		uint64_t * w = DA.data();
+		uint64_t ones = 0;
+
+		for(uint64_t i=0;i<n_words;++i){
+
+			if(i%words_per_super == 0) (*dir)[i/words_per_super] = ones;
+			ones += __builtin_popcountll(w[i]);
+
+		}
+
+		if(n_words%words_per_super == 0) dir->back() = ones;
+
+		uint64_t header[DA_HEADER_WORDS] = {0, n, ones, dir->size()};
+		char * magic = (char*)header;
+		std::memcpy(magic, DA_MAGIC, 4);
+		magic[4] = DA_VERSION;
+
+		vector<uint64_t> h(header, header + DA_HEADER_WORDS);
+
+		uint64_t n_items = DA_HEADER_WORDS + n_words + dir->size();
+
+		out.write_formatted(path, n_items, sizeof(uint64_t), [h, w, n_words, dir](uint64_t begin, uint64_t end, char * buf){
+
+			uint64_t * b = (uint64_t*)buf;
+
+			for(uint64_t k=begin;k<end;++k){
+
+				if(k < DA_HEADER_WORDS) b[k-begin] = h[k];
+				else if(k < DA_HEADER_WORDS + n_words) b[k-begin] = w[k-DA_HEADER_WORDS];
+				else b[k-begin] = (*dir)[k-DA_HEADER_WORDS-n_words];
+
+			}
+
+		});
+
+		return n_items * sizeof(uint64_t);
+
+	}
+
+	/*
+	 * map the binary DA stored in path (read-only)
+	 */
+	packed_da(string path){
+
+		int fd = open(path.c_str(), O_RDONLY);
+
+		struct stat st;
+
+		if(fd < 0 or fstat(fd, &st) != 0 or uint64_t(st.st_size) < DA_HEADER_WORDS*sizeof(uint64_t)){
+
+			cout << "Error: cannot open binary document array " << path << endl;
+			exit(1);
+
+		}
+
+		bytes = st.st_size;
+
+		void * p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if(p == MAP_FAILED){
+
+			cout << "Error: cannot map file " << path << endl;
+			exit(1);
+
+		}
+
+		file = (uint64_t*)p;
+
+		n = file[1];
+		ones = file[2];
+		n_super = file[3];
+		n_words = n/64 + (n%64 != 0);
+
+		words = file + DA_HEADER_WORDS;
+		dir = words + n_words;
+
+		if(std::memcmp(file, DA_MAGIC, 4) != 0 or ((char*)file)[4] != DA_VERSION or
+			n_super != n_words/(DA_SUPERBLOCK/64) + 1 or bytes != (DA_HEADER_WORDS + n_words + n_super)*sizeof(uint64_t)){
+
+			cout << "Error: " << path << " is not a binary document array" << endl;
+			exit(1);
+
+		}
+
+	}
+
+	packed_da(const packed_da &) = delete;
+	packed_da & operator=(const packed_da &) = delete;
+
+	~packed_da(){
+
+		munmap(file, bytes);
+
+	}
+
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * collection (0 or 1) of the i-th suffix
+	 */
+	inline bool operator[](uint64_t i){
+
+		assert(i<n);
+		return (words[i/64] >> (i%64)) & 1;
+
+	}
+
+	/*
+	 * number of 1s (suffixes of collection 2) in positions [0, i)
+	 */
+	inline uint64_t rank1(uint64_t i){
+
+		assert(i<=n);
+
+		uint64_t s = i/DA_SUPERBLOCK;
+		uint64_t r = dir[s];
+
+		for(uint64_t k = s*(DA_SUPERBLOCK/64); k < i/64; ++k) r += __builtin_popcountll(words[k]);
+
+		if(i%64 != 0) r += __builtin_popcountll(words[i/64] & ((uint64_t(1) << (i%64)) - 1));
+
+		return r;
+
+	}
+
+	/*
+	 * number of 0s (suffixes of collection 1) in positions [0, i)
+	 */
+	inline uint64_t rank0(uint64_t i){
+
+		return i - rank1(i);
+
+	}
+
+	/*
+	 * position of the k-th 1 (k >= 1)
+	 */
+	uint64_t select1(uint64_t k){
+
+		assert(k >= 1 and k <= ones);
+
+		return select(k, true);
+
+	}
+
+	/*
+	 * position of the k-th 0 (k >= 1)
+	 */
+	uint64_t select0(uint64_t k){
+
+		assert(k >= 1 and k <= n - ones);
+
+		return select(k, false);
+
+	}
+
+private:
+
+	/*
+	 * binary search on the directory, then scan the words of the superblock
+	 */
+	uint64_t select(uint64_t k, bool bit){
+
+		//ones (or zeros) before superblock s
+		auto before = [&](uint64_t s){ return bit ? dir[s] : std::min(s*DA_SUPERBLOCK, n) - dir[s]; };
+
+		//last superblock with less than k bits before it
+		uint64_t lo = 0, hi = n_super - 1;
+
+		while(lo < hi){
+
+			uint64_t mid = (lo + hi + 1)/2;
+
+			if(before(mid) < k) lo = mid;
+			else hi = mid - 1;
+
+		}
+
+		k -= before(lo);
+
+		for(uint64_t w = lo*(DA_SUPERBLOCK/64); w < n_words; ++w){
+
+			uint64_t x = bit ? words[w] : ~words[w];
+			if(w == n_words-1 and n%64 != 0) x &= (uint64_t(1) << (n%64)) - 1;
+
+			uint64_t c = __builtin_popcountll(x);
+
+			if(c >= k){
+
+				//k-th set bit of x
+				for(; k > 1; --k) x &= x - 1;
+
+				return w*64 + __builtin_ctzll(x);
+
+			}
+
+			k -= c;
+
+		}
+
+		assert(false);
+		return n;
+
+	}
+
+	uint64_t * file = NULL;
+	uint64_t bytes = 0;
+
+	uint64_t n = 0;
+	uint64_t ones = 0;
+	uint64_t n_words = 0;
+	uint64_t n_super = 0;
+
+	uint64_t * words = NULL;
+	uint64_t * dir = NULL;
+
+};
+
+#endif /* INTERNAL_PACKED_DA_HPP_ */
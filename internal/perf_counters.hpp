@@ -0,0 +1,167 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * perf_counters.hpp
+ *
+ *  Created on: Jan 16, 2019
+ *      Author: nico
+ *
+ *  Hardware performance counters (last-level cache misses, dTLB misses, instructions, cycles) of the calling
+ *  thread and of the threads it creates after the counters are opened (e.g. the output writers of the save phase),
+ *  read with perf_event_open (Linux only). User-space events only, so that the default perf_event_paranoid setting
+ *  is enough.
+ *
+ *  The counts of exited threads are not cleared by a reset: each phase reports the difference between the values
+ *  read at stop and at start.
+ *
+ *  If a counter cannot be opened (other OS, virtual machine without PMU, restrictive perf_event_paranoid, ...)
+ *  it is simply marked as unavailable: start/stop are no-ops for it.
+ *
+ */
+
+#ifndef INTERNAL_PERF_COUNTERS_HPP_
+#define INTERNAL_PERF_COUNTERS_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+#define N_PERF_COUNTERS 4
+
+class perf_counters{
+
+public:
+
+	enum counter_t {LLC_MISSES = 0, DTLB_MISSES = 1, INSTRUCTIONS = 2, CYCLES = 3};
+
+	perf_counters(){
+
+#ifdef __linux__
+
+		uint64_t LL_read_miss = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		uint64_t DTLB_read_miss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+		fd[LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE, LL_read_miss);
+
+		//not all PMUs expose last-level cache read misses: fall back to the generic cache-miss event
+		if(fd[LLC_MISSES] < 0) fd[LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+		fd[DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE, DTLB_read_miss);
+		fd[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		fd[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+
+#endif
+
+	}
+
+	~perf_counters(){
+
+		for(int i=0;i<N_PERF_COUNTERS;++i) if(fd[i] >= 0) close(fd[i]);
+
+	}
+
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+
+	/*
+	 * true iff at least one counter is available
+	 */
+	bool available(){
+
+		for(int i=0;i<N_PERF_COUNTERS;++i) if(fd[i] >= 0) return true;
+
+		return false;
+
+	}
+
+	bool available(counter_t c){
+		return fd[c] >= 0;
+	}
+
+	/*
+	 * reset and start all counters
+	 */
+	void start(){
+
+#ifdef __linux__
+
+		for(int i=0;i<N_PERF_COUNTERS;++i){
+
+			if(fd[i] < 0) continue;
+
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+
+			if(read(fd[i], &begin[i], sizeof(uint64_t)) != sizeof(uint64_t)) begin[i] = 0;
+
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+
+		}
+
+#endif
+
+	}
+
+	/*
+	 * stop all counters and store their values in value[] (0 for unavailable counters)
+	 */
+	void stop(uint64_t * value){
+
+		for(int i=0;i<N_PERF_COUNTERS;++i){
+
+			value[i] = 0;
+
+#ifdef __linux__
+
+			if(fd[i] < 0) continue;
+
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+			if(read(fd[i], &value[i], sizeof(uint64_t)) != sizeof(uint64_t) or value[i] < begin[i]) value[i] = 0;
+			else value[i] -= begin[i];
+
+#endif
+
+		}
+
+	}
+
+private:
+
+#ifdef __linux__
+
+	static int open_counter(uint32_t type, uint64_t config){
+
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = 1;//also threads created later
+
+		//this thread, any CPU
+		return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+	}
+
+#endif
+
+	int fd[N_PERF_COUNTERS] = {-1,-1,-1,-1};
+	uint64_t begin[N_PERF_COUNTERS] = {};//values at start (see above)
+
+};
+
+#endif /* INTERNAL_PERF_COUNTERS_HPP_ */
@@ -0,0 +1,235 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * progress.hpp
+ *
+ *  Created on: Jan 16, 2019
+ *      Author: nico
+ *
+ *  Progress reporting for the suffix tree traversals. The traversal loop publishes its counters (number of
+ *  computed values, processed items, current stack depth) only once every PROGRESS_MASK+1 iterations, with
+ *  relaxed atomic stores: no division, no I/O and no synchronization in the hot loop.
+ *
+ *  A background thread wakes up every PROGRESS_POLL_MS milliseconds and prints percentage, throughput
+ *  (values per second) and ETA when the percentage has increased, at most once every PROGRESS_MIN_MS
+ *  milliseconds. Sending SIGUSR1 to the process prints all current counters of the running phase.
+ *
+ *  Usage:
+ *
+ *  	progress P("nodes", n, {"LCP", "DA"}, lcp_values, da_values);
+ *  	while(...){ ...; if((nodes & PROGRESS_MASK) == 0) P.update(nodes, S.size(), lcp_values, da_values); }
+ *  	P.stop();
+ *
+ *  ETA is estimated from the first counter.
+ *
+ */
+
+#ifndef INTERNAL_PROGRESS_HPP_
+#define INTERNAL_PROGRESS_HPP_
+
+#define PROGRESS_MASK 0x3FF		//publish counters every 1024 iterations
+#define PROGRESS_POLL_MS 100	//reporter wake-up interval
+#define PROGRESS_MIN_MS 1000	//min interval between two progress lines
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <csignal>
+
+using namespace std;
+
+//set by the SIGUSR1 handler, consumed by the reporter thread
+static volatile sig_atomic_t progress_dump_requested = 0;
+
+static void progress_sigusr1_handler(int){
+
+	progress_dump_requested = 1;
+
+}
+
+class progress{
+
+public:
+
+	/*
+	 * phase = name of the phase, n = total number of values of each counter, names = counter names (1 or 2),
+	 * v0, v1 = values of the counters at the beginning of the phase
+	 */
+	progress(string phase, uint64_t n, vector<string> names, uint64_t v0 = 0, uint64_t v1 = 0){
+
+		this->phase = phase;
+		this->n = n;
+		this->names = names;
+
+		base = v0;
+		update(0, 0, v0, v1);
+
+		install_handler();
+		progress_dump_requested = 0;
+
+		start = chrono::steady_clock::now();
+		reporter = thread(&progress::report, this);
+
+	}
+
+	~progress(){
+
+		stop();
+
+	}
+
+	/*
+	 * publish the current counters. Cheap: call it every PROGRESS_MASK+1 iterations of the traversal.
+	 */
+	inline void update(uint64_t items, uint64_t stack_depth, uint64_t v0, uint64_t v1 = 0){
+
+		this->items.store(items, memory_order_relaxed);
+		this->stack_depth.store(stack_depth, memory_order_relaxed);
+		values[0].store(v0, memory_order_relaxed);
+		values[1].store(v1, memory_order_relaxed);
+
+	}
+
+	/*
+	 * install the SIGUSR1 handler (done automatically by the first progress). Tools call it at startup, so that
+	 * SIGUSR1 received outside traversal phases (e.g. while loading the input) does not terminate the process.
+	 */
+	static void install_handler(){
+
+		static bool installed = false;
+
+		if(installed) return;
+
+		struct sigaction sa;
+		sa.sa_handler = progress_sigusr1_handler;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &sa, NULL);
+
+		installed = true;
+
+	}
+
+	/*
+	 * terminate the reporter thread
+	 */
+	void stop(){
+
+		if(not reporter.joinable()) return;
+
+		{
+			unique_lock<mutex> lock(mtx);
+			done = true;
+		}
+
+		wake.notify_all();
+		reporter.join();
+
+	}
+
+private:
+
+	double elapsed(){
+
+		return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	}
+
+	/*
+	 * body of the reporter thread
+	 */
+	void report(){
+
+		int last_perc = -1;
+		double last_print = 0;
+
+		unique_lock<mutex> lock(mtx);
+
+		while(not done){
+
+			wake.wait_for(lock, chrono::milliseconds(PROGRESS_POLL_MS));
+
+			if(done) break;
+
+			if(progress_dump_requested){
+
+				progress_dump_requested = 0;
+				dump();
+
+			}
+
+			uint64_t v = values[0].load(memory_order_relaxed);
+			int perc = n == 0 ? 100 : int((100*v)/n);
+			double t = elapsed();
+
+			if(perc > last_perc and (t - last_print)*1000 >= PROGRESS_MIN_MS){
+
+				print_line(t);
+
+				last_perc = perc;
+				last_print = t;
+
+			}
+
+		}
+
+	}
+
+	/*
+	 * percentages of all counters, throughput and ETA of the first counter
+	 */
+	void print_line(double t){
+
+		uint64_t v = values[0].load(memory_order_relaxed);
+
+		for(uint64_t i=0;i<names.size();++i)
+			cout << names[i] << ": " << (n == 0 ? 100 : (100*values[i].load(memory_order_relaxed))/n) << "%. ";
+
+		double rate = t > 0 ? (v-base)/t : 0;
+
+		cout << "(" << uint64_t(rate) << " " << names[0] << " values/s";
+		if(rate > 0) cout << ", ETA " << uint64_t((n-v)/rate) << " s";
+		cout << ")" << endl;
+
+	}
+
+	void dump(){
+
+		cout << "[SIGUSR1] phase " << phase << ", elapsed " << elapsed() << " s: ";
+
+		for(uint64_t i=0;i<names.size();++i)
+			cout << names[i] << " " << values[i].load(memory_order_relaxed) << "/" << n << ", ";
+
+		cout << "processed items " << items.load(memory_order_relaxed) << ", stack depth " <<
+				stack_depth.load(memory_order_relaxed) << endl;
+
+	}
+
+	string phase;
+	uint64_t n = 0;
+	vector<string> names;
+
+	uint64_t base = 0;//value of the first counter at the beginning of the phase
+
+	atomic<uint64_t> values[2] = {{0},{0}};
+	atomic<uint64_t> items{0};
+	atomic<uint64_t> stack_depth{0};
+
+	chrono::steady_clock::time_point start;
+
+	mutex mtx;
+	condition_variable wake;
+	bool done = false;
+
+	thread reporter;
+
+};
+
+#endif /* INTERNAL_PROGRESS_HPP_ */
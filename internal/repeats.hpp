@@ -0,0 +1,319 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * repeats.hpp
+ *
+ *  Created on: Jan 28, 2019
+ *      Author: nico
+ *
+ *  Maximal repeats found during the suffix-tree navigation (bwt2lcp -R, merge_bwt -R): strings W occurring at least
+ *  twice that are right-maximal (followed by at least two distinct characters) and left-maximal (preceded by at least
+ *  two distinct characters), each terminator being a distinct character. An occurrence at the beginning (end) of a
+ *  read therefore makes W left- (right-) maximal: duplicated reads, and prefixes and suffixes shared by reads, are
+ *  maximal repeats.
+ *
+ *  The traversal counts the terminator as one child, so its nodes are the right-maximal strings followed by at least
+ *  one character of the alphabet. The others are the terminal strings, whose occurrences are all followed by a
+ *  terminator: these are found by class terminal_strings below.
+ *
+ *  Repeats file: a header of 64-bit little-endian words
+ *
+ *  	[0]          magic "DREP", then version (1 Byte), then 3 Bytes = 0
+ *  	[1]          L (minimum length of a reported repeat)
+ *  	[2]          number of repeats
+ *  	[3]          number of words per record
+ *
+ *  followed by one record per repeat, in traversal order, starting with |W| (see bwt2lcp and bwt_merger.hpp for the
+ *  other words).
+ *
+ */
+
+#ifndef INTERNAL_REPEATS_HPP_
+#define INTERNAL_REPEATS_HPP_
+
+#define REP_MAGIC "DREP"
+#define REP_VERSION 2
+#define REP_HEADER_WORDS 4
+#define REP_BUFFER (1<<16) //records buffered before each write
+
+#include "include.hpp"
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * number of occurrences of each character before the suffixes whose extensions are e, terminators last.
+ * size = number of suffixes.
+ */
+inline void letter_counts(p_range e, uint64_t size, uint64_t * c){
+
+	c[0] = range_length(e.A);
+	c[1] = range_length(e.C);
+	c[2] = range_length(e.G);
+	c[3] = range_length(e.T);
+	c[4] = size - std::accumulate(c, c+4, uint64_t(0));
+
+}
+
+inline void letter_counts(p_range_n e, uint64_t size, uint64_t * c){
+
+	c[0] = range_length(e.A);
+	c[1] = range_length(e.C);
+	c[2] = range_length(e.G);
+	c[3] = range_length(e.N);
+	c[4] = range_length(e.T);
+	c[5] = size - std::accumulate(c, c+5, uint64_t(0));
+
+}
+
+/*
+ * true iff the size >= 2 suffixes are preceded by at least two distinct characters: c contains sigma counts, the
+ * last one of terminators (all distinct)
+ */
+inline bool left_maximal(uint64_t * c, uint64_t sigma, uint64_t size){
+
+	if(size < 2) return false;
+	if(c[sigma-1] > 0) return true;
+
+	return std::none_of(c, c+sigma-1, [size](uint64_t x){ return x == size; });
+
+}
+
+/*
+ * ranges of the extensions aW (a = A,C,G,(N),T) in e. Returns their number.
+ */
+inline int letter_ranges(p_range e, range_t * r){
+
+	r[0] = e.A;
+	r[1] = e.C;
+	r[2] = e.G;
+	r[3] = e.T;
+
+	return 4;
+
+}
+
+inline int letter_ranges(p_range_n e, range_t * r){
+
+	r[0] = e.A;
+	r[1] = e.C;
+	r[2] = e.G;
+	r[3] = e.N;
+	r[4] = e.T;
+
+	return 5;
+
+}
+
+/*
+ * terminal strings (see above) with at least two occurrences, in K = 1 or 2 BWTs. With K = 2, only the strings
+ * occurring in both BWTs are visited.
+ *
+ * A terminal string is cV, where V is either a node or a terminal string, and the occurrences of cV are those of
+ * cV.TERM. Starting from each node V (method visit), the terminal strings are navigated by Weiner links with a
+ * stack of ranges, and report(depth, r) is called on the left-maximal ones of length >= min_length (r[k] = range of
+ * the string in BWT k).
+ */
+template<class bwt_t, int K>
+class terminal_strings{
+
+public:
+
+	terminal_strings(){}
+
+	terminal_strings(bwt_t * bwt1, bwt_t * bwt2, uint64_t min_length) : min_length(min_length) {
+
+		bwt[0] = bwt1;
+		bwt[1] = bwt2;
+
+	}
+
+	/*
+	 * visit the terminal strings descending from node V of the given depth. node[k] = range of V in BWT k, term[k]
+	 * = range of V.TERM in BWT k.
+	 */
+	template<class report_t>
+	void visit(range_t * node, range_t * term, uint64_t depth, report_t report){
+
+		uint64_t terminal = 0;
+		for(int k = 0; k < K; ++k) terminal += range_length(term[k]);
+
+		if(terminal < 2) return;
+
+		//cV is terminal iff cV and cV.TERM have the same occurrences
+
+		range_t full[K][5], ext[K][5];
+		int sigma = 0;
+
+		for(int k = 0; k < K; ++k){
+
+			letter_ranges(bwt[k]->LF(node[k]), full[k]);
+			sigma = letter_ranges(bwt[k]->LF(term[k]), ext[k]);
+
+		}
+
+		for(int a = sigma-1; a >= 0; --a){
+
+			bool same = true;
+			for(int k = 0; k < K; ++k) same = same and range_length(full[k][a]) == range_length(ext[k][a]);
+
+			if(same) push(ext, a, depth+1);
+
+		}
+
+		while(not S.empty()){
+
+			item X = S.back();
+			S.pop_back();
+
+			uint64_t c[6] = {};
+			uint64_t size = 0;
+
+			for(int k = 0; k < K; ++k){
+
+				sigma = letter_ranges(bwt[k]->LF(X.r[k]), ext[k]);
+
+				for(int a = 0; a < sigma; ++a) c[a] += range_length(ext[k][a]);
+				size += range_length(X.r[k]);
+
+			}
+
+			c[sigma] = size - std::accumulate(c, c+sigma, uint64_t(0));//terminators
+
+			if(X.depth >= min_length and left_maximal(c, sigma+1, size)) report(X.depth, X.r);
+
+			for(int a = sigma-1; a >= 0; --a) push(ext, a, X.depth+1);
+
+		}
+
+	}
+
+private:
+
+	struct item{
+
+		range_t r[K];
+		uint64_t depth;
+
+	};
+
+	//push the extension by the a-th letter, if it has at least two occurrences (in each BWT, if K = 2)
+	inline void push(range_t ext[K][5], int a, uint64_t depth){
+
+		item X;
+		X.depth = depth;
+
+		uint64_t size = 0;
+
+		for(int k = 0; k < K; ++k){
+
+			X.r[k] = ext[k][a];
+			size += range_length(X.r[k]);
+
+			if(K == 2 and range_length(X.r[k]) == 0) return;
+
+		}
+
+		if(size >= 2) S.push_back(X);
+
+	}
+
+	bwt_t * bwt[2] = {NULL, NULL};
+	uint64_t min_length = 1;
+
+	vector<item> S;
+
+};
+
+/*
+ * streams the records of a repeats file
+ */
+class repeat_writer{
+
+public:
+
+	repeat_writer(){}
+
+	/*
+	 * create the file and write its header (the number of repeats is patched by close)
+	 */
+	repeat_writer(string path, uint64_t min_length, uint64_t record_words) : record_words(record_words) {
+
+		out = ofstream(path, ios::binary);
+
+		if(not out.is_open()){
+
+			cout << "Error: could not open file " << path << endl;
+			exit(1);
+
+		}
+
+		uint64_t header[REP_HEADER_WORDS] = {0, min_length, 0, record_words};
+
+		memcpy(header, REP_MAGIC, 4);
+		header[0] |= uint64_t(REP_VERSION) << 32;
+
+		out.write((char*)header, sizeof(header));
+
+	}
+
+	/*
+	 * append one record of record_words words
+	 */
+	inline void add(const uint64_t * rec){
+
+		buf.insert(buf.end(), rec, rec + record_words);
+		repeats++;
+
+		if(buf.size() >= REP_BUFFER*record_words) flush();
+
+	}
+
+	void close(){
+
+		flush();
+
+		out.seekp(2*sizeof(uint64_t));
+		out.write((char*)&repeats, sizeof(uint64_t));
+		out.close();
+
+	}
+
+	/*
+	 * number of added repeats
+	 */
+	uint64_t size(){
+		return repeats;
+	}
+
+	/*
+	 * size of the file
+	 */
+	uint64_t bytes(){
+		return (REP_HEADER_WORDS + repeats*record_words)*sizeof(uint64_t);
+	}
+
+private:
+
+	void flush(){
+
+		out.write((char*)buf.data(), buf.size()*sizeof(uint64_t));
+		buf.clear();
+
+	}
+
+	ofstream out;
+	vector<uint64_t> buf;//records not yet written
+
+	uint64_t record_words = 0;
+	uint64_t repeats = 0;
+
+};
+
+#endif /* INTERNAL_REPEATS_HPP_ */
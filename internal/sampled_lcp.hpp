@@ -0,0 +1,196 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * sampled_lcp.hpp
+ *
+ *  Created on: Jan 25, 2019
+ *      Author: nico
+ *
+ *  LCP values at the run boundaries of the BWT only (position 0, and positions i-1, i for each run head i), as
+ *  needed by r-index and move-structure construction: O(r) values instead of n.
+ *
+ *  Sampled positions are stored in a compact sorted array: the low SLCP_BUCKET_BITS bits of each position
+ *  (uint16_t), plus the index of the first sample of each bucket of 2^SLCP_BUCKET_BITS positions and, relative
+ *  to it, of each sub-bucket of 2^SLCP_SUB_BITS positions (uint16_t): a lookup is a binary search among the samples
+ *  of one sub-bucket. RAM r'*(B+2) + 8n/2^SLCP_BUCKET_BITS + 2n/2^SLCP_SUB_BITS Bytes, with r' <= 2r sampled positions.
+ *
+ *  operator[] has the interface of the LCP array used by update_lcp: values at positions that are not sampled
+ *  are written to a scratch variable and discarded.
+ *
+ */
+
+#ifndef INTERNAL_SAMPLED_LCP_HPP_
+#define INTERNAL_SAMPLED_LCP_HPP_
+
+#define SLCP_BUCKET_BITS 16
+#define SLCP_SUB_BITS 8
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+template<typename lcp_int_t>
+class sampled_lcp{
+
+public:
+
+	sampled_lcp(){}
+
+	/*
+	 * sample the run boundaries of bwt. All values are set to init.
+	 */
+	template<class bwt_t>
+	sampled_lcp(bwt_t & bwt, lcp_int_t init){
+
+		n = bwt.size();
+
+		first = vector<uint64_t>((n >> SLCP_BUCKET_BITS) + 2, 0);
+		sub = vector<uint16_t>((n >> SLCP_SUB_BITS) + 2, 0);
+
+		uint64_t last = 0;//last sampled position
+
+		auto sample = [&](uint64_t i){
+
+			if(low.size() > 0 and i == last) return;
+
+			low.push_back(i & mask);
+			first[(i >> SLCP_BUCKET_BITS) + 1]++;
+			sub[(i >> SLCP_SUB_BITS) + 1]++;
+			last = i;
+
+		};
+
+		sample(0);
+
+		bwt.for_each_run_head([&](uint64_t i){
+
+			sample(i-1);
+			sample(i);
+
+		});
+
+		sample(n-1);
+
+		//bucket counts to prefix sums
+		for(uint64_t b = 1; b < first.size(); ++b) first[b] += first[b-1];
+
+		//sub-bucket counts to prefix sums inside each bucket (sub[j] holds the count of sub-bucket j-1)
+		uint64_t subs = uint64_t(1) << (SLCP_BUCKET_BITS - SLCP_SUB_BITS);//sub-buckets per bucket
+
+		for(uint64_t j = 0; j < sub.size(); ++j) sub[j] = j%subs == 0 ? 0 : sub[j] + sub[j-1];
+
+		V = vector<lcp_int_t>(low.size(), init);
+
+	}
+
+	/*
+	 * number of LCP positions (sampled or not)
+	 */
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * number of sampled positions
+	 */
+	uint64_t samples(){
+		return low.size();
+	}
+
+	/*
+	 * LCP value of position i if i is sampled, otherwise a scratch value (equal to nil)
+	 */
+	inline lcp_int_t & operator[](uint64_t i){
+
+		assert(i<n);
+
+		uint64_t b = i >> SLCP_BUCKET_BITS;
+		uint64_t k = lower_bound(b, i);
+
+		if(k < first[b+1] and low[k] == (i & mask)) return V[k];
+
+		scratch = ~lcp_int_t(0);
+		return scratch;
+
+	}
+
+	/*
+	 * set the values of all sampled positions in [begin, end) to v
+	 */
+	void fill(uint64_t begin, uint64_t end, lcp_int_t v){
+
+		if(begin >= end) return;
+
+		uint64_t b = begin >> SLCP_BUCKET_BITS;
+		uint64_t k = lower_bound(b, begin);
+
+		for(; k < low.size(); ++k){
+
+			while(k >= first[b+1]) ++b;
+
+			if(((b << SLCP_BUCKET_BITS) | low[k]) >= end) break;
+
+			V[k] = v;
+
+		}
+
+	}
+
+	/*
+	 * values of the sampled positions, in increasing position order
+	 */
+	lcp_int_t * data(){
+		return V.data();
+	}
+
+	/*
+	 * the sampled positions in [k, k+len), in increasing order (len > 0)
+	 */
+	void positions(uint64_t k, uint64_t len, uint64_t * out){
+
+		uint64_t b = std::upper_bound(first.begin(), first.end(), k) - first.begin() - 1;//bucket of sample k
+
+		for(uint64_t j = k; j < k+len; ++j){
+
+			while(j >= first[b+1]) ++b;
+
+			out[j-k] = (b << SLCP_BUCKET_BITS) | low[j];
+
+		}
+
+	}
+
+private:
+
+	/*
+	 * first sample of bucket b = i >> SLCP_BUCKET_BITS with position >= i
+	 */
+	inline uint64_t lower_bound(uint64_t b, uint64_t i){
+
+		uint64_t j = i >> SLCP_SUB_BITS;
+
+		uint64_t begin = first[b] + sub[j];
+		uint64_t end = ((j+1) >> (SLCP_BUCKET_BITS - SLCP_SUB_BITS)) != b ? first[b+1] : first[b] + sub[j+1];
+
+		return std::lower_bound(low.begin() + begin, low.begin() + end, uint16_t(i & mask)) - low.begin();
+
+	}
+
+	static const uint64_t mask = (uint64_t(1) << SLCP_BUCKET_BITS) - 1;
+
+	uint64_t n = 0;
+
+	vector<uint16_t> low;//low bits of the sampled positions
+	vector<uint64_t> first;//first[b] = index of the first sample of bucket b
+	vector<uint16_t> sub;//sub[j] = index of the first sample of sub-bucket j, minus the first of its bucket
+	vector<lcp_int_t> V;//values of the sampled positions
+
+	lcp_int_t scratch = 0;
+
+};
+
+#endif /* INTERNAL_SAMPLED_LCP_HPP_ */
@@ -0,0 +1,311 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * st_traversal.hpp
+ *
+ *  Created on: Jan 23, 2019
+ *      Author: nico
+ *
+ *  Generic depth-first traversal of the leaves and of the internal nodes of the (generalized) suffix tree of one
+ *  BWT (single_tree) or of the union of two BWTs (pair_tree: leaves and nodes are pairs, one per BWT), following
+ *  Weiner links. The traversal is driven by a visitor, whose callbacks are inlined at compile time:
+ *
+ *  	bool on_leaf(leaf_t & L)    process leaf L; return true to follow the Weiner links of L
+ *  	bool on_node(node_t & N)    process node N; return true to follow the Weiner links of N
+ *  	void on_sample(uint64_t items, uint64_t max_stack, stack<leaf_t or node_t> & S)
+ *  	                            called every PROGRESS_MASK+1 visited leaves/nodes with the current state of the
+ *  	                            traversal (progress reports, checkpoints)
+ *
+ *  The engine uses only the stack (O(log n) words): whatever is computed from the visited leaves and nodes (LCP, DA,
+ *  statistics, repeats, graphs) is up to the visitor, in the same pass.
+ *
+ */
+
+#ifndef INTERNAL_ST_TRAVERSAL_HPP_
+#define INTERNAL_ST_TRAVERSAL_HPP_
+
+#include "dna_bwt.hpp"
+#include "dna_bwt_n.hpp"
+#include "include.hpp"
+#include "progress.hpp"
+#include <stack>
+#include <algorithm>
+
+using namespace std;
+
+inline void next_leaves(dna_bwt_t * bwt1, dna_bwt_t * bwt2, sa_leaf & L1, sa_leaf & L2, vector<pair<sa_leaf, sa_leaf> > & TMP_LEAVES, int & t, int min_size){
+
+	p_range ext_1 = bwt1->LF(L1.rn);
+	p_range ext_2 = bwt2->LF(L2.rn);
+
+	//push non-empty leaves on stack in decreasing size order
+
+	t = 0;
+
+	if(range_length(ext_1.A) + range_length(ext_2.A) >= min_size) TMP_LEAVES[t++] = {{ext_1.A, L1.depth+1},{ext_2.A, L2.depth+1}};
+	if(range_length(ext_1.C) + range_length(ext_2.C) >= min_size) TMP_LEAVES[t++] = {{ext_1.C, L1.depth+1},{ext_2.C, L2.depth+1}};
+	if(range_length(ext_1.G) + range_length(ext_2.G) >= min_size) TMP_LEAVES[t++] = {{ext_1.G, L1.depth+1},{ext_2.G, L2.depth+1}};
+	if(range_length(ext_1.T) + range_length(ext_2.T) >= min_size) TMP_LEAVES[t++] = {{ext_1.T, L1.depth+1},{ext_2.T, L2.depth+1}};
+
+	std::sort( TMP_LEAVES.begin(), TMP_LEAVES.begin()+t, [ ]( const pair<sa_leaf, sa_leaf>& lhs, const pair<sa_leaf, sa_leaf>& rhs )
+	{
+		return leaf_size(lhs) < leaf_size(rhs);
+	});
+
+}
+
+inline void next_leaves(dna_bwt_n_t * bwt1, dna_bwt_n_t * bwt2, sa_leaf & L1, sa_leaf & L2, vector<pair<sa_leaf, sa_leaf> > & TMP_LEAVES, int & t, int min_size){
+
+	p_range_n ext_1 = bwt1->LF(L1.rn);
+	p_range_n ext_2 = bwt2->LF(L2.rn);
+
+	//push non-empty leaves on stack in decreasing size order
+
+	t = 0;
+
+	if(range_length(ext_1.A) + range_length(ext_2.A) >= min_size) TMP_LEAVES[t++] = {{ext_1.A, L1.depth+1},{ext_2.A, L2.depth+1}};
+	if(range_length(ext_1.C) + range_length(ext_2.C) >= min_size) TMP_LEAVES[t++] = {{ext_1.C, L1.depth+1},{ext_2.C, L2.depth+1}};
+	if(range_length(ext_1.G) + range_length(ext_2.G) >= min_size) TMP_LEAVES[t++] = {{ext_1.G, L1.depth+1},{ext_2.G, L2.depth+1}};
+	if(range_length(ext_1.N) + range_length(ext_2.N) >= min_size) TMP_LEAVES[t++] = {{ext_1.N, L1.depth+1},{ext_2.N, L2.depth+1}};
+	if(range_length(ext_1.T) + range_length(ext_2.T) >= min_size) TMP_LEAVES[t++] = {{ext_1.T, L1.depth+1},{ext_2.T, L2.depth+1}};
+
+	std::sort( TMP_LEAVES.begin(), TMP_LEAVES.begin()+t, [ ]( const pair<sa_leaf, sa_leaf>& lhs, const pair<sa_leaf, sa_leaf>& rhs )
+	{
+		return leaf_size(lhs) < leaf_size(rhs);
+	});
+
+}
+
+
+inline void next_nodes(dna_bwt_t * bwt1, dna_bwt_t * bwt2, sa_node & N1, sa_node & N2, vector<pair<sa_node, sa_node> > & TMP_NODES, int & t){
+
+	p_node left_exts1 = bwt1->LF(N1);
+	p_node left_exts2 = bwt2->LF(N2);
+
+	pair<sa_node, sa_node> A = {left_exts1.A, left_exts2.A};
+	pair<sa_node, sa_node> C = {left_exts1.C, left_exts2.C};
+	pair<sa_node, sa_node> G = {left_exts1.G, left_exts2.G};
+	pair<sa_node, sa_node> T = {left_exts1.T, left_exts2.T};
+
+	t = 0;
+
+	if(number_of_children(A) >= 2) TMP_NODES[t++] = A;
+	if(number_of_children(C) >= 2) TMP_NODES[t++] = C;
+	if(number_of_children(G) >= 2) TMP_NODES[t++] = G;
+	if(number_of_children(T) >= 2) TMP_NODES[t++] = T;
+
+	//push right-maximal nodes on stack in decreasing size (i.e. interval length) order
+
+	std::sort( TMP_NODES.begin(), TMP_NODES.begin()+t, [ ]( const pair<sa_node, sa_node>& lhs, const pair<sa_node, sa_node>& rhs )
+	{
+		return node_size(lhs) < node_size(rhs);
+	});
+
+}
+
+inline void next_nodes(dna_bwt_n_t * bwt1, dna_bwt_n_t * bwt2, sa_node_n & N1, sa_node_n & N2, vector<pair<sa_node_n, sa_node_n> > & TMP_NODES, int & t){
+
+	p_node_n left_exts1 = bwt1->LF(N1);
+	p_node_n left_exts2 = bwt2->LF(N2);
+
+	pair<sa_node_n, sa_node_n> A = {left_exts1.A, left_exts2.A};
+	pair<sa_node_n, sa_node_n> C = {left_exts1.C, left_exts2.C};
+	pair<sa_node_n, sa_node_n> G = {left_exts1.G, left_exts2.G};
+	pair<sa_node_n, sa_node_n> N = {left_exts1.N, left_exts2.N};
+	pair<sa_node_n, sa_node_n> T = {left_exts1.T, left_exts2.T};
+
+	t = 0;
+
+	if(number_of_children(A) >= 2) TMP_NODES[t++] = A;
+	if(number_of_children(C) >= 2) TMP_NODES[t++] = C;
+	if(number_of_children(G) >= 2) TMP_NODES[t++] = G;
+	if(number_of_children(N) >= 2) TMP_NODES[t++] = N;
+	if(number_of_children(T) >= 2) TMP_NODES[t++] = T;
+
+	//push right-maximal nodes on stack in decreasing size (i.e. interval length) order
+
+	std::sort( TMP_NODES.begin(), TMP_NODES.begin()+t, [ ]( const pair<sa_node_n, sa_node_n>& lhs, const pair<sa_node_n, sa_node_n>& rhs )
+	{
+		return node_size(lhs) < node_size(rhs);
+	});
+
+}
+
+/*
+ * suffix tree of one BWT
+ */
+template<class bwt_t>
+class single_tree{
+
+public:
+
+	typedef sa_leaf leaf_t;
+	typedef typename bwt_t::sa_node_t node_t;
+
+	single_tree(bwt_t * bwt) : bwt(bwt) {}
+
+	leaf_t first_leaf(){
+		return bwt->first_leaf();
+	}
+
+	node_t root(){
+		return bwt->root();
+	}
+
+	inline void next_leaves(leaf_t & L, vector<leaf_t> & TMP_LEAVES, int & t, int min_size){
+		bwt->next_leaves(L, TMP_LEAVES, t, min_size);
+	}
+
+	inline void next_nodes(node_t & N, vector<node_t> & TMP_NODES, int & t){
+		bwt->next_nodes(N, TMP_NODES, t);
+	}
+
+private:
+
+	bwt_t * bwt = NULL;
+
+};
+
+/*
+ * generalized suffix tree of the union of two BWTs. Leaves and nodes are pairs (one leaf/node per BWT, possibly
+ * empty). If mixed_only is true, node pairs with an empty side (which, with all their Weiner-link descendants,
+ * contain suffixes of only one collection) are not visited.
+ */
+template<class bwt_t>
+class pair_tree{
+
+public:
+
+	typedef pair<sa_leaf, sa_leaf> leaf_t;
+	typedef pair<typename bwt_t::sa_node_t, typename bwt_t::sa_node_t> node_t;
+
+	pair_tree(bwt_t * bwt1, bwt_t * bwt2, bool mixed_only = false) : bwt1(bwt1), bwt2(bwt2), mixed_only(mixed_only) {}
+
+	leaf_t first_leaf(){
+		return {bwt1->first_leaf(), bwt2->first_leaf()};
+	}
+
+	node_t root(){
+		return {bwt1->root(), bwt2->root()};
+	}
+
+	inline void next_leaves(leaf_t & L, vector<leaf_t> & TMP_LEAVES, int & t, int min_size){
+		::next_leaves(bwt1, bwt2, L.first, L.second, TMP_LEAVES, t, min_size);
+	}
+
+	inline void next_nodes(node_t & N, vector<node_t> & TMP_NODES, int & t){
+
+		::next_nodes(bwt1, bwt2, N.first, N.second, TMP_NODES, t);
+
+		if(not mixed_only) return;
+
+		int k = 0;
+
+		for(int i=0;i<t;++i)
+			if(node_size(TMP_NODES[i].first) > 0 and node_size(TMP_NODES[i].second) > 0) TMP_NODES[k++] = TMP_NODES[i];
+
+		t = k;
+
+	}
+
+private:
+
+	bwt_t * bwt1 = NULL;
+	bwt_t * bwt2 = NULL;
+
+	bool mixed_only = false;
+
+};
+
+template<class tree_t>
+class st_traversal{
+
+public:
+
+	typedef typename tree_t::leaf_t leaf_t;
+	typedef typename tree_t::node_t node_t;
+
+	st_traversal(tree_t tree) : tree(tree) {}
+
+	leaf_t first_leaf(){
+		return tree.first_leaf();
+	}
+
+	node_t root(){
+		return tree.root();
+	}
+
+	/*
+	 * visit the leaves of size >= min_size reachable from those in S (usually, S contains only first_leaf()). items and
+	 * max_stack (visited leaves, maximum stack size) are updated starting from their current value, so that a traversal
+	 * resumed from a saved stack continues its counters.
+	 */
+	template<class visitor_t>
+	void visit_leaves(visitor_t & V, stack<leaf_t> & S, uint64_t & items, uint64_t & max_stack, int min_size = 1){
+
+		while(not S.empty()){
+
+			max_stack = S.size() > max_stack ? S.size() : max_stack;
+
+			leaf_t L = S.top();
+			S.pop();
+			items++;
+
+			if(V.on_leaf(L)){
+
+				int t = 0;
+
+				tree.next_leaves(L, TMP_LEAVES, t, min_size);
+
+				for(int i=t-1;i>=0;--i) S.push(TMP_LEAVES[i]);
+
+			}
+
+			if((items & PROGRESS_MASK) == 0) V.on_sample(items, max_stack, S);
+
+		}
+
+	}
+
+	/*
+	 * visit the internal nodes reachable from those in S (usually, S contains only root()). Counters as in visit_leaves.
+	 */
+	template<class visitor_t>
+	void visit_nodes(visitor_t & V, stack<node_t> & S, uint64_t & items, uint64_t & max_stack){
+
+		while(not S.empty()){
+
+			max_stack = S.size() > max_stack ? S.size() : max_stack;
+
+			node_t N = S.top();
+			S.pop();
+			items++;
+
+			if(V.on_node(N)){
+
+				int t = 0;
+
+				tree.next_nodes(N, TMP_NODES, t);
+
+				for(int i=t-1;i>=0;--i) S.push(TMP_NODES[i]);
+
+			}
+
+			if((items & PROGRESS_MASK) == 0) V.on_sample(items, max_stack, S);
+
+		}
+
+	}
+
+private:
+
+	tree_t tree;
+
+	vector<leaf_t> TMP_LEAVES = vector<leaf_t>(5);
+	vector<node_t> TMP_NODES = vector<node_t>(5);
+
+};
+
+#endif /* INTERNAL_ST_TRAVERSAL_HPP_ */
@@ -0,0 +1,294 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * stats.hpp
+ *
+ *  Created on: Jan 14, 2019
+ *      Author: nico
+ *
+ *  Statistics of a run, split by phase (e.g. leaves navigation, nodes navigation, output). If available,
+ *  hardware performance counters of the calling thread (and of the threads it creates, see perf_counters.hpp) are
+ *  sampled at the beginning and end of each phase.
+ *
+ *  Besides phases, a run has global properties (tool, alphabet, LCP width, filled LCP/DA values, bytes read and
+ *  written, ...) stored as key/value pairs. The whole report can be saved in JSON format with save_json.
+ *
+ */
+
+#ifndef INTERNAL_STATS_HPP_
+#define INTERNAL_STATS_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <sys/resource.h>
+#include "perf_counters.hpp"
+
+using namespace std;
+
+struct phase_stats{
+
+	string name;
+
+	double wall = 0;//wall-clock time, seconds
+	double cpu = 0;//user + system CPU time of the process (all threads), seconds
+	uint64_t items = 0;//number of processed items (leaves, nodes, characters ...)
+	uint64_t max_stack = 0;//max stack depth of the traversal
+
+	bool has_counters = false;//hardware counters were available during this phase
+	uint64_t counters[N_PERF_COUNTERS] = {};//indexed by perf_counters::counter_t
+
+};
+
+class run_stats{
+
+public:
+
+	/*
+	 * start a new phase. Phases cannot be nested.
+	 */
+	void begin_phase(string name){
+
+		phase_stats p;
+		p.name = name;
+
+		phases.push_back(p);
+
+		if(not pc) pc = make_shared<perf_counters>();
+
+		start = chrono::steady_clock::now();
+		start_cpu = cpu_seconds();
+		pc->start();
+
+	}
+
+	/*
+	 * end current phase. items = number of processed items, max_stack = max stack depth (if the phase is a traversal)
+	 */
+	void end_phase(uint64_t items = 0, uint64_t max_stack = 0){
+
+		pc->stop(phases.back().counters);
+		phases.back().has_counters = pc->available();
+
+		phases.back().wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		phases.back().cpu = cpu_seconds() - start_cpu;
+		phases.back().items = items;
+		phases.back().max_stack = max_stack;
+
+	}
+
+	/*
+	 * set a global property of the run (overwritten if already present)
+	 */
+	void set(string key, uint64_t value){
+
+		set_json(key, to_string(value));
+
+	}
+
+	void set(string key, string value){
+
+		string escaped;
+
+		for(char c : value){
+
+			if(c == '"' or c == '\\') escaped += '\\';
+			escaped += c;
+
+		}
+
+		set_json(key, "\"" + escaped + "\"");
+
+	}
+
+	/*
+	 * histogram (value, count pairs), stored as an array of [value, count] arrays
+	 */
+	void set(string key, const vector<pair<uint64_t, uint64_t> > & H){
+
+		string json = "[";
+
+		for(uint64_t i = 0; i < H.size(); ++i)
+			json += (i == 0 ? "[" : ", [") + to_string(H[i].first) + ", " + to_string(H[i].second) + "]";
+
+		set_json(key, json + "]");
+
+	}
+
+	/*
+	 * append phases and properties of another run (e.g. the phases of an lcp run to the load phase of a tool)
+	 */
+	void append(run_stats & other){
+
+		phases.insert(phases.end(), other.phases.begin(), other.phases.end());
+
+		for(auto & kv : other.info) set_json(kv.first, kv.second);
+
+	}
+
+	/*
+	 * save the report in JSON format. Throughput is computed over the total wall-clock time of the phases
+	 * and the property "n" (number of input characters), if set.
+	 */
+	void save_json(string path){
+
+		ofstream out(path);
+
+		double wall = 0;
+		double cpu = 0;
+
+		for(auto & p : phases){
+
+			wall += p.wall;
+			cpu += p.cpu;
+
+		}
+
+		out << "{" << endl;
+
+		for(auto & kv : info) out << "\t\"" << kv.first << "\": " << kv.second << "," << endl;
+
+		out << "\t\"peak_rss_bytes\": " << peak_rss() << "," << endl;
+		out << "\t\"wall_seconds\": " << wall << "," << endl;
+		out << "\t\"cpu_seconds\": " << cpu << "," << endl;
+
+		for(auto & kv : info)
+			if(kv.first == "n") out << "\t\"throughput_chars_per_second\": " << (wall > 0 ? stod(kv.second)/wall : 0) << "," << endl;
+
+		out << "\t\"phases\": [";
+
+		for(uint64_t i = 0; i < phases.size(); ++i){
+
+			phase_stats & p = phases[i];
+
+			out << (i == 0 ? "" : ",") << endl << "\t\t{\"name\": \"" << p.name << "\", \"wall_seconds\": " << p.wall <<
+					", \"cpu_seconds\": " << p.cpu << ", \"items\": " << p.items << ", \"max_stack\": " << p.max_stack;
+
+			if(p.has_counters){
+
+				out << ", \"llc_misses\": " << p.counters[perf_counters::LLC_MISSES] <<
+						", \"dtlb_misses\": " << p.counters[perf_counters::DTLB_MISSES] <<
+						", \"instructions\": " << p.counters[perf_counters::INSTRUCTIONS] <<
+						", \"cycles\": " << p.counters[perf_counters::CYCLES];
+
+			}
+
+			out << "}";
+
+		}
+
+		out << endl << "\t]" << endl << "}" << endl;
+
+		out.close();
+
+	}
+
+	/*
+	 * total wall-clock time of the phases with the given name (0 if none)
+	 */
+	double seconds(string name){
+
+		double t = 0;
+
+		for(auto & p : phases) if(p.name == name) t += p.wall;
+
+		return t;
+
+	}
+
+	/*
+	 * print the hardware counters of the last phase, normalized by the input size n and by the number of
+	 * processed items (item_name = name of an item, e.g. "leaf")
+	 */
+	void print_counters(uint64_t n, string item_name){
+
+		phase_stats & p = phases.back();
+
+		if(not p.has_counters){
+
+			cout << "Hardware performance counters not available." << endl;
+			return;
+
+		}
+
+		const string names[2] = {"LLC misses", "dTLB misses"};
+
+		for(int c = perf_counters::LLC_MISSES; c <= perf_counters::DTLB_MISSES; ++c){
+
+			if(not pc->available(perf_counters::counter_t(c))) continue;
+
+			cout << names[c] << ": " << p.counters[c] << " (" << double(p.counters[c])/(n == 0 ? 1 : n) << " per input character";
+			if(p.items > 0) cout << ", " << double(p.counters[c])/p.items << " per " << item_name;
+			cout << ")" << endl;
+
+		}
+
+		if(pc->available(perf_counters::INSTRUCTIONS) and pc->available(perf_counters::CYCLES) and p.counters[perf_counters::CYCLES] > 0){
+
+			cout << "Instructions: " << p.counters[perf_counters::INSTRUCTIONS] << ", cycles: " << p.counters[perf_counters::CYCLES] <<
+					" (IPC " << double(p.counters[perf_counters::INSTRUCTIONS])/p.counters[perf_counters::CYCLES] << ")" << endl;
+
+		}
+
+	}
+
+	vector<phase_stats> phases;
+
+	//global properties: key, value already formatted as JSON
+	vector<pair<string, string> > info;
+
+private:
+
+	void set_json(string key, string value){
+
+		for(auto & kv : info){
+
+			if(kv.first == key){
+
+				kv.second = value;
+				return;
+
+			}
+
+		}
+
+		info.push_back({key, value});
+
+	}
+
+	static double cpu_seconds(){
+
+		rusage r;
+		getrusage(RUSAGE_SELF, &r);
+
+		return 	r.ru_utime.tv_sec + r.ru_stime.tv_sec + (r.ru_utime.tv_usec + r.ru_stime.tv_usec)/1e6;
+
+	}
+
+	/*
+	 * peak resident set size of the process, Bytes
+	 */
+	static uint64_t peak_rss(){
+
+		rusage r;
+		getrusage(RUSAGE_SELF, &r);
+
+		return uint64_t(r.ru_maxrss)*1024;//KiB on Linux
+
+	}
+
+	shared_ptr<perf_counters> pc;
+
+	double start_cpu = 0;
+
+	chrono::steady_clock::time_point start;
+
+};
+
+#endif /* INTERNAL_STATS_HPP_ */
@@ -11,7 +11,9 @@
 
 #include <iostream>
 #include "internal/bwt_merger.hpp"
+#include "internal/diff_kmers.hpp"
 #include <unistd.h>
+#include <getopt.h>
 #include "internal/dna_bwt.hpp"
 #include "internal/dna_bwt_n.hpp"
 
@@ -19,38 +21,243 @@ using namespace std;
 
 string input_bwt1;
 string input_bwt2;
+string input_lcp1;
+string input_lcp2;
 string output_file;
 
 bool out_da = false;
+bool ascii_da = false;//-d
+bool binary_da = false;//-D
+bool packed_bwt = false;
 uint8_t lcp_size = 0;
 
 bool containsN = false;
 
 char TERM = '#';
 
+uint64_t n_threads = 0;
+
+string stats_json;
+
+uint64_t ckpt_seconds = 0;
+bool resume = false;
+
+bool mmap_output = false;
+bool compress_lcp = false;
+
+uint64_t depth_cap = 0;
+
+uint64_t min_repeat = 0;
+
+uint64_t kmer_k = 0;
+kmer_filter kmer_f;
+
 void help(){
 
 	cout << "merge_bwt [options]" << endl <<
 	"Merges the eBWTs of two collections of reads by navigating the (compressed) generalized suffix tree of their union." << endl <<
 	"Options:" << endl <<
 	"-h          Print this help" << endl <<
-	"-1 <arg>    Input BWT 1 (REQUIRED)" << endl <<
-	"-2 <arg>    Input BWT 2 (REQUIRED)" << endl <<
+	"-1 <arg>    Input BWT 1: ASCII file or packed index (.dbwt) (REQUIRED)" << endl <<
+	"-2 <arg>    Input BWT 2: ASCII file or packed index (.dbwt) (REQUIRED)" << endl <<
 	"-o <arg>    Output prefix (REQUIRED)" << endl <<
 	"-d          Output document array as an ASCII file of 0/1. Default: do not output." << endl <<
+	"-D          Output document array as a bit vector with rank/select directory (extension .bda, see internal/packed_da.hpp). Not with -d." << endl <<
+	"-x          Store the merged BWT as a packed, rank-ready index (extension .dbwt) instead of ASCII (.bwt)." << endl <<
 	"-l <arg>    Output LCP of the merged BWT using <arg>=0,1,2,4,8 Bytes" << endl <<
 	"            per integer. If arg=0, LCP is not computed (faster). Default: 0." << endl <<
+	"-a <arg>    LCP of BWT 1, using the same number of Bytes per integer as -l (optional, use together with -b)." << endl <<
+	"-b <arg>    LCP of BWT 2, using the same number of Bytes per integer as -l (optional, use together with -a)." << endl <<
+	"            Merged LCP values inside runs of the DA are copied from the input LCPs: only suffix tree nodes" << endl <<
+	"            containing suffixes of both collections are navigated (much faster on nearly disjoint collections)." << endl <<
 	//"-n          Alphabet is {A,C,G,N,T," << TERM << "}. Default: alphabet is {A,C,G,T," << TERM << "}."<< endl <<
-	"-t          Ascii code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl;
+	"-t          Ascii code of the terminator. Default:" << int('#') << " (#). Cannot be the code for A,C,G,T,N." << endl <<
+	"-p <arg>    Number of threads used to format and write the output (with -k: to navigate the k-mers). Default: number of hardware threads." << endl <<
+	"-m          Build the merged LCP directly in the output file (memory mapped) instead of in RAM: no final copy," << endl <<
+	"            and the kernel can page it out under memory pressure." << endl <<
+	"-K <arg>    Compute min(LCP, <arg>) instead of the merged LCP: suffix tree nodes deeper than <arg> are not visited." << endl <<
+	"            <arg> must be smaller than 2^(8*B)-1, B = Bytes per LCP value (-l). Default: no cap." << endl <<
+	"-z          Store the merged LCP in compressed form (extension .lcpz: blocks of bit-packed differences from the" << endl <<
+	"            block minimum), with random access to single values (see internal/compressed_lcp.hpp). Not compatible with -m." << endl <<
+	"-R <arg>    (--shared-repeats <arg>) Store to prefix.rep the maximal repeats of length >= <arg> shared by the two" << endl <<
+	"            collections, with their number of occurrences and BWT intervals (see internal/bwt_merger.hpp)." << endl <<
+	"            Works also without LCP (-l 0). Not compatible with -K, -c, -r." << endl <<
+	"-k <arg>    (--diff-kmers <arg>) Do not merge: store to prefix.kmers the <arg>-mers (<arg> <= " << KMR_MAX_K << ") whose numbers of" << endl <<
+	"            occurrences c1, c2 in the two collections pass the filter -f (see internal/diff_kmers.hpp)." << endl <<
+	"            Only -f, -t, -p, -j can be used together with -k." << endl <<
+	"-f <arg>    (--kmer-filter <arg>) Filter min1:max1:min2:max2 for -k: min1 <= c1 <= max1 and min2 <= c2 <= max2." << endl <<
+	"            An empty max means no limit. Default: 1::0:0 (k-mers present in collection 1 and absent in collection 2)." << endl <<
+	"-c <arg>    Save a checkpoint every <arg> seconds (files with extension .ckpt*, next to the output). Default: no checkpoints." << endl <<
+	"-r          (--resume) Resume from the last checkpoint of a previous run with the same inputs, options and output." << endl <<
+	"            If -c is not given, checkpoints are saved every " << CHECKPOINT_DEFAULT_SECONDS << " seconds." << endl <<
+	"-j <arg>    (--stats-json <arg>) Save a JSON report of the run (phase times, counters, peak memory, throughput) to file <arg>." << endl;
 	exit(0);
 }
 
+/*
+ * load the two BWTs, merge them (computing the LCP with lcp_int_t integers if compute_lcp) and store the output.
+ * Global statistics of the run (including BWT loading) are saved to stats_json, if set.
+ */
+template<class bwt_t, typename lcp_int_t>
+void run(string alphabet, bool compute_lcp){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWTs ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT1 = bwt_t(input_bwt1, TERM);
+	bwt_t BWT2 = bwt_t(input_bwt2, TERM);
+
+	stats.end_phase(BWT1.size() + BWT2.size());
+
+	cout << "Done. Size of BWTs: " << BWT1.size() << " and " << BWT2.size() << endl;
+
+	merge_options opt;
+
+	opt.compute_lcp = compute_lcp;
+	opt.out_da = out_da;
+	opt.lcp1_path = input_lcp1;
+	opt.lcp2_path = input_lcp2;
+	opt.ckpt_path = ckpt_seconds > 0 ? output_file : "";
+	opt.ckpt_seconds = ckpt_seconds;
+	opt.resume = resume;
+	opt.lcp_path = mmap_output ? output_file + ".lcp" : "";
+	opt.depth_cap = depth_cap;
+	opt.repeats_path = min_repeat > 0 ? output_file + ".rep" : "";
+	opt.min_repeat = min_repeat;
+	opt.out_path = output_file;
+	opt.n_threads = n_threads;
+	opt.packed_bwt = packed_bwt;
+	opt.binary_da = binary_da;
+
+	bwt_merger<bwt_t, lcp_int_t> M(&BWT1, &BWT2, opt);
+
+	cout << "Storing output to file ... " << endl;
+	M.save_to_file(output_file, n_threads, packed_bwt, binary_da, compress_lcp);
+
+	if(stats_json.size()==0) return;
+
+	uint64_t bytes_read = uint64_t(filesize(input_bwt1)) + uint64_t(filesize(input_bwt2));
+	if(input_lcp1.size()>0) bytes_read += uint64_t(filesize(input_lcp1)) + uint64_t(filesize(input_lcp2));
+
+	stats.set("tool", string("merge_bwt"));
+	stats.set("input1", input_bwt1);
+	stats.set("input2", input_bwt2);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("lcp_bytes", compute_lcp ? sizeof(lcp_int_t) : 0);
+	stats.set("bytes_read", bytes_read);
+	stats.append(M.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+/*
+ * load the two BWTs and store their k-mers passing kmer_f (no merge).
+ */
+template<class bwt_t>
+void run_kmers(string alphabet){
+
+	run_stats stats;
+
+	cout << "Loading and indexing BWTs ... " << endl;
+
+	stats.begin_phase("load");
+
+	bwt_t BWT1 = bwt_t(input_bwt1, TERM);
+	bwt_t BWT2 = bwt_t(input_bwt2, TERM);
+
+	stats.end_phase(BWT1.size() + BWT2.size());
+
+	cout << "Done. Size of BWTs: " << BWT1.size() << " and " << BWT2.size() << endl;
+
+	diff_kmers<bwt_t> D(&BWT1, &BWT2, kmer_k, kmer_f, output_file + ".kmers", n_threads);
+
+	if(stats_json.size()==0) return;
+
+	stats.set("tool", string("merge_bwt"));
+	stats.set("input1", input_bwt1);
+	stats.set("input2", input_bwt2);
+	stats.set("output", output_file);
+	stats.set("alphabet", alphabet);
+	stats.set("bytes_read", uint64_t(filesize(input_bwt1)) + uint64_t(filesize(input_bwt2)));
+	stats.append(D.stats);
+
+	stats.save_json(stats_json);
+
+	cout << "Statistics saved to " << stats_json << endl;
+
+}
+
+/*
+ * parse a k-mer filter min1:max1:min2:max2 (empty max = no limit)
+ */
+bool parse_filter(string s, kmer_filter & f){
+
+	vector<string> v(1);
+
+	for(char c : s){
+
+		if(c == ':') v.push_back("");
+		else if(c >= '0' and c <= '9') v.back() += c;
+		else return false;
+
+	}
+
+	if(v.size() != 4 or v[0].size() == 0 or v[2].size() == 0) return false;
+
+	f.min1 = stoull(v[0]);
+	f.max1 = v[1].size() > 0 ? stoull(v[1]) : ~uint64_t(0);
+	f.min2 = stoull(v[2]);
+	f.max2 = v[3].size() > 0 ? stoull(v[3]) : ~uint64_t(0);
+
+	return true;
+
+}
+
+template<class bwt_t>
+void run(string alphabet){
+
+	if(kmer_k > 0){
+
+		run_kmers<bwt_t>(alphabet);
+		return;
+
+	}
+
+	switch(lcp_size){
+
+		case 0: run<bwt_t, uint8_t>(alphabet, false); break;
+		case 1: run<bwt_t, uint8_t>(alphabet, true); break;
+		case 2: run<bwt_t, uint16_t>(alphabet, true); break;
+		case 4: run<bwt_t, uint32_t>(alphabet, true); break;
+		case 8: run<bwt_t, uint64_t>(alphabet, true); break;
+		default:break;
+
+	}
+
+}
+
 int main(int argc, char** argv){
 
 	if(argc < 4) help();
 
+	static struct option long_options[] = {
+		{"stats-json", required_argument, 0, 'j'},
+		{"resume", no_argument, 0, 'r'},
+		{"shared-repeats", required_argument, 0, 'R'},
+		{"diff-kmers", required_argument, 0, 'k'},
+		{"kmer-filter", required_argument, 0, 'f'},
+		{0, 0, 0, 0}
+	};
+
 	int opt;
-	while ((opt = getopt(argc, argv, "h1:2:o:l:dt:")) != -1){
+	while ((opt = getopt_long(argc, argv, "h1:2:a:b:o:l:dDxt:p:j:c:rmzK:R:k:f:", long_options, NULL)) != -1){
 		switch (opt){
 			case 'h':
 				help();
@@ -61,6 +268,12 @@ int main(int argc, char** argv){
 			case '2':
 				input_bwt2 = string(optarg);
 			break;
+			case 'a':
+				input_lcp1 = string(optarg);
+			break;
+			case 'b':
+				input_lcp2 = string(optarg);
+			break;
 			case 'o':
 				output_file = string(optarg);
 			break;
@@ -70,8 +283,53 @@ int main(int argc, char** argv){
 			case 't':
 				TERM = atoi(optarg);
 			break;
+			case 'p':
+				n_threads = atoi(optarg);
+			break;
 			case 'd':
 				out_da = true;
+				ascii_da = true;
+			break;
+			case 'D':
+				out_da = true;
+				binary_da = true;
+			break;
+			case 'x':
+				packed_bwt = true;
+			break;
+			case 'j':
+				stats_json = string(optarg);
+			break;
+			case 'c':
+				ckpt_seconds = atoll(optarg);
+			break;
+			case 'r':
+				resume = true;
+			break;
+			case 'm':
+				mmap_output = true;
+			break;
+			case 'z':
+				compress_lcp = true;
+			break;
+			case 'K':
+				depth_cap = atoll(optarg);
+			break;
+			case 'k':
+				kmer_k = atoll(optarg);
+				if(kmer_k == 0 or kmer_k > KMR_MAX_K) help();
+			break;
+			case 'f':
+				if(not parse_filter(string(optarg), kmer_f)){
+
+					cout << "Error: invalid k-mer filter " << optarg << endl;
+					help();
+
+				}
+			break;
+			case 'R':
+				min_repeat = atoll(optarg);
+				if(min_repeat == 0) help();
 			break;
 			/*case 'n':
 				containsN = true;
@@ -92,86 +350,66 @@ int main(int argc, char** argv){
 	if(input_bwt1.size()==0) help();
 	if(input_bwt2.size()==0) help();
 	if(output_file.size()==0) help();
+	if((input_lcp1.size()>0) != (input_lcp2.size()>0)) help();
+	if(input_lcp1.size()>0 and lcp_size==0) help();
 
 	cout << "Input bwt 1: " << input_bwt1 << endl;
 	cout << "Input bwt 2: " << input_bwt2 << endl;
 	cout << "Output prefix: " << output_file << endl;
 
+	if(depth_cap > 0 and (lcp_size == 0 or (lcp_size < 8 and depth_cap >= (uint64_t(1) << (8*lcp_size)) - 1))){
+
+		cout << "Error: the depth cap (-K) requires an LCP width (-l) able to represent it" << endl;
+		help();
+
+	}
+
+	if(mmap_output and compress_lcp){
+
+		cout << "Error: options -m and -z cannot be used together" << endl;
+		help();
+
+	}
+
+	if(min_repeat > 0 and (depth_cap > 0 or ckpt_seconds > 0 or resume)){
+
+		cout << "Error: option -R cannot be used together with -K, -c, -r" << endl;
+		help();
+
+	}
+
+	if(ascii_da and binary_da){
+
+		cout << "Error: options -d and -D cannot be used together" << endl;
+		help();
+
+	}
+
+	if(kmer_k > 0 and (lcp_size > 0 or input_lcp1.size() > 0 or out_da or packed_bwt or mmap_output or compress_lcp or
+			depth_cap > 0 or min_repeat > 0 or ckpt_seconds > 0 or resume)){
+
+		cout << "Error: option -k can be used only together with -f, -t, -p, -j" << endl;
+		help();
+
+	}
+
+	if(resume and ckpt_seconds == 0) ckpt_seconds = CHECKPOINT_DEFAULT_SECONDS;
+
+	progress::install_handler();//SIGUSR1: print current counters
+
 	containsN = hasN(input_bwt1) or hasN(input_bwt2);
 
 	if(not containsN){
 
 		cout << "Alphabet: A,C,G,T,'" << TERM << "'" << endl;
 
-		cout << "Loading and indexing BWTs ... " << endl;
-
-		dna_bwt_t BWT1 = dna_bwt_t(input_bwt1, TERM);
-		dna_bwt_t BWT2 = dna_bwt_t(input_bwt2, TERM);
-
-		cout << "Done. Size of BWTs: " << BWT1.size() << " and " << BWT2.size() << endl;
-
-		switch(lcp_size){
-
-			case 0: { bwt_merger<dna_bwt_t, uint8_t> M0(&BWT1, &BWT2, false, out_da);
-					cout << "Storing output to file ... " << endl;
-					M0.save_to_file(output_file);
-					break; }
-			case 1: { bwt_merger<dna_bwt_t, uint8_t> M1(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M1.save_to_file(output_file);
-					break;}
-			case 2: {bwt_merger<dna_bwt_t, uint16_t> M2(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M2.save_to_file(output_file);
-					break;}
-			case 4: {bwt_merger<dna_bwt_t, uint32_t> M4(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M4.save_to_file(output_file);
-					break;}
-			case 8: {bwt_merger<dna_bwt_t, uint64_t> M8(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M8.save_to_file(output_file);
-					break;}
-			default:break;
-
-		}
+		run<dna_bwt_t>("ACGT");
 
 	}else{
 
 		cout << "Alphabet: A,C,G,N,T,'" << TERM << "'" << endl;
 
-		cout << "Loading and indexing BWTs ... " << endl;
-
-		dna_bwt_n_t BWT1 = dna_bwt_n_t(input_bwt1, TERM);
-		dna_bwt_n_t BWT2 = dna_bwt_n_t(input_bwt2, TERM);
-
-		cout << "Done. Size of BWTs: " << BWT1.size() << " and " << BWT2.size() << endl;
-
-		switch(lcp_size){
-
-			case 0: { bwt_merger<dna_bwt_n_t, uint8_t> M0(&BWT1, &BWT2, false, out_da);
-					cout << "Storing output to file ... " << endl;
-					M0.save_to_file(output_file);
-					break; }
-			case 1: { bwt_merger<dna_bwt_n_t, uint8_t> M1(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M1.save_to_file(output_file);
-					break;}
-			case 2: {bwt_merger<dna_bwt_n_t, uint16_t> M2(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M2.save_to_file(output_file);
-					break;}
-			case 4: {bwt_merger<dna_bwt_n_t, uint32_t> M4(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M4.save_to_file(output_file);
-					break;}
-			case 8: {bwt_merger<dna_bwt_n_t, uint64_t> M8(&BWT1, &BWT2, true, out_da);
-					cout << "Storing output to file ... " << endl;
-					M8.save_to_file(output_file);
-					break;}
-			default:break;
-
-		}
+		run<dna_bwt_n_t>("ACGNT");
 
 	}
 
@@ -0,0 +1,265 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * test_boss.cpp
+ *
+ *  Created on: Jan 30, 2019
+ *      Author: nico
+ *
+ *  Regression test of the BOSS representation of bwt2dbg -b (see internal/dbg.hpp): the file is decoded with the
+ *  BOSS navigation (forward: edge -> node, backward: node -> its incoming edge) and checked against the k-mers and
+ *  (k+1)-mers of the reads counted by brute force. Usage: test_boss [directory for temporary files]. Exit code 0 iff
+ *  all checks pass.
+ */
+
+#include <iostream>
+#include <set>
+#include <map>
+#include "internal/dbg.hpp"
+#include "internal/dna_bwt.hpp"
+#include "internal/dna_bwt_n.hpp"
+#include "bench/read_generator.hpp"
+
+using namespace std;
+
+string tmp_dir = "/tmp";
+streambuf * cout_buf = NULL;
+ofstream null_stream;
+
+int failed = 0;
+
+void check(bool ok, string what){
+
+	cerr << (ok ? "OK     " : "FAILED ") << what << endl;
+	if(not ok) failed++;
+
+}
+
+/*
+ * substrings of length l over A,C,G,T of the reads occurring at least c times
+ */
+set<string> frequent(vector<string> & reads, uint64_t l, uint64_t c){
+
+	map<string, uint64_t> count;
+
+	for(auto & r : reads)
+		for(uint64_t i = 0; i+l <= r.size(); ++i)
+			if(r.substr(i, l).find('N') == string::npos) count[r.substr(i, l)]++;
+
+	set<string> S;
+	for(auto & x : count) if(x.second >= c) S.insert(x.first);
+
+	return S;
+
+}
+
+/*
+ * a .boss file, navigated as in Bowe et al.
+ */
+struct boss{
+
+	uint64_t header[DBG_HEADER_WORDS];
+	vector<uint8_t> labels;
+
+	vector<uint64_t> node_of;//node of each edge
+	vector<uint64_t> first_edge;//first edge of each node
+	vector<uint64_t> start = vector<uint64_t>(6);//first node whose first symbol is $, A, C, G, T; then number of nodes
+
+	vector<vector<uint64_t> > non_minus = vector<vector<uint64_t> >(5);//edges without bit 3, by label
+
+	bool ok = true;
+
+	boss(string path){
+
+		ifstream in(path, ios::binary);
+
+		in.read((char*)header, sizeof(header));
+
+		if(memcmp(header, DBG_MAGIC, 4) != 0 or ((char*)header)[4] != DBG_VERSION){
+
+			ok = false;
+			return;
+
+		}
+
+		labels.resize(header[3]);
+		in.read((char*)labels.data(), labels.size());
+
+		for(uint64_t e = 0; e < labels.size(); ++e){
+
+			if(e == 0 or (labels[e-1] >> 4)) first_edge.push_back(e);
+			node_of.push_back(first_edge.size()-1);
+
+			if(((labels[e] >> 3) & 1) == 0) non_minus[labels[e] & 7].push_back(e);
+
+		}
+
+		start[1] = header[2] - header[4] - header[5] - header[6] - header[7];//the node $^k, if any
+		for(uint64_t c = 1; c <= 4; ++c) start[c+1] = start[c] + header[3+c];
+
+	}
+
+	uint64_t nodes(){
+		return first_edge.size();
+	}
+
+	uint64_t symbol(uint64_t v){
+		uint64_t c = 0;
+		while(start[c+1] <= v) c++;
+		return c;
+	}
+
+	/*
+	 * node reached by edge e (label != $)
+	 */
+	uint64_t forward(uint64_t e){
+
+		uint64_t c = labels[e] & 7;
+
+		//a minus edge reaches the node of the previous edge with the same label
+		while((labels[e] >> 3) & 1) while((labels[--e] & 7) != c);
+
+		auto & E = non_minus[c];
+		return start[c] + (std::lower_bound(E.begin(), E.end(), e) - E.begin());
+
+	}
+
+	/*
+	 * edge reaching node v (v is not $^k)
+	 */
+	uint64_t backward(uint64_t v){
+
+		uint64_t c = symbol(v);
+		return non_minus[c][v - start[c]];
+
+	}
+
+	string label(uint64_t v){
+
+		string s;
+
+		for(uint64_t i = 0; i < header[1]; ++i){
+
+			uint64_t c = symbol(v);
+			s += "$ACGT"[c];
+
+			if(c > 0) v = node_of[backward(v)];
+
+		}
+
+		return s;
+
+	}
+
+};
+
+template<class bwt_t>
+void test_boss(vector<string> reads, uint64_t k, uint64_t c, string what){
+
+	what = "k = " + to_string(k) + ", c = " + to_string(c) + ": " + what;
+
+	string bwt = ebwt(reads);
+	save_string(tmp_dir + "/test_boss.bwt", bwt);
+
+	bwt_t BWT(tmp_dir + "/test_boss.bwt");
+
+	cout.rdbuf(null_stream.rdbuf());
+	dbg_builder<bwt_t> G(&BWT, k, c, true, tmp_dir + "/test_boss", 2);
+	cout.rdbuf(cout_buf);
+
+	boss B(tmp_dir + "/test_boss.boss");
+
+	check(B.ok, "header, " + what);
+	if(not B.ok) return;
+
+	bool sizes = B.nodes() == B.header[2] and B.start[1] <= 1;
+	for(uint64_t a = 1; a <= 4; ++a) sizes = sizes and B.non_minus[a].size() == B.header[3+a];
+
+	check(sizes, "non-minus labels per symbol = nodes per first symbol, " + what);
+	if(not sizes) return;
+
+	//every node but $^k is reached by one edge, and every non-minus edge reaches the node it comes from
+	bool round_trip = true;
+
+	for(uint64_t v = B.start[1]; v < B.nodes(); ++v) round_trip = round_trip and B.forward(B.backward(v)) == v;
+
+	for(uint64_t a = 1; a <= 4; ++a)
+		for(auto e : B.non_minus[a]) round_trip = round_trip and B.backward(B.forward(e)) == e;
+
+	check(round_trip, "forward/backward round trip, " + what);
+	if(not round_trip) return;
+
+	//nodes sorted, and the nodes and edges without '$' are those of the reads
+	set<string> nodes, edges;
+	string prev;
+	bool sorted = true;
+	uint64_t dummies = 0;
+
+	for(uint64_t v = 0; v < B.nodes(); ++v){
+
+		string X = B.label(v);
+
+		sorted = sorted and (v == 0 or prev < X);
+		prev = X;
+
+		if(X.find('$') != string::npos){
+
+			dummies++;
+			continue;
+
+		}
+
+		nodes.insert(X);
+
+		for(uint64_t e = B.first_edge[v]; e < B.labels.size() and B.node_of[e] == v; ++e)
+			if(B.labels[e] & 7) edges.insert(string(1, "$ACGT"[B.labels[e] & 7]) + X);
+
+	}
+
+	check(sorted and dummies == B.header[8], "nodes sorted, dummy nodes, " + what);
+	check(nodes == frequent(reads, k, c) and edges == frequent(reads, k+1, c), "nodes and edges, " + what);
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc > 1) tmp_dir = string(argv[1]);
+
+	cout_buf = cout.rdbuf();
+
+	//CT has no extension CTb: reached by the chain $$ -> T$ -> CT
+	test_boss<dna_bwt_t>({"ACGTTGCAAG", "GGGTACCA", "TTTTCAGGCT"}, 2, 1, "small");
+	test_boss<dna_bwt_t>({"ACGTTGCAAG", "GGGTACCA", "TTTTCAGGCT"}, 1, 1, "small");
+
+	read_collection_params p;
+	p.genome_length = 300;
+	p.read_length = 30;
+	p.coverage = 5;
+	p.error_rate = 0.02;
+
+	for(uint64_t seed = 1; seed <= 3; ++seed){
+
+		p.seed = seed;
+		p.n_rate = 0;
+		auto r = generate_reads(p, seed);
+
+		for(uint64_t k : {3, 6, 12})
+			for(uint64_t c : {1, 2})
+				test_boss<dna_bwt_t>(r, k, c, "random reads, seed " + to_string(seed));
+
+		p.n_rate = 0.02;
+		auto n = generate_reads(p, seed);
+
+		test_boss<dna_bwt_n_t>(n, 6, 1, "random reads with N, seed " + to_string(seed));
+		test_boss<dna_bwt_n_t>(n, 6, 2, "random reads with N, seed " + to_string(seed));
+
+	}
+
+	for(string f : {"/test_boss.bwt", "/test_boss.boss"})
+		remove((tmp_dir + f).c_str());
+
+	return failed == 0 ? 0 : 1;
+
+}
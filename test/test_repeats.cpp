@@ -0,0 +1,284 @@
+// Copyright (c) 2018, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * test_repeats.cpp
+ *
+ *  Created on: Jan 29, 2019
+ *      Author: nico
+ *
+ *  Regression test of the maximal repeats of bwt2lcp -R and merge_bwt -R (see internal/repeats.hpp): the repeats
+ *  files are compared with the maximal repeats found by brute force on the reads, each terminator being a distinct
+ *  character. Usage: test_repeats [directory for temporary files]. Exit code 0 iff all checks pass.
+ */
+
+#include <iostream>
+#include <set>
+#include <map>
+#include <tuple>
+#include "internal/lcp.hpp"
+#include "internal/bwt_merger.hpp"
+#include "bench/read_generator.hpp"
+
+using namespace std;
+
+typedef vector<uint64_t> record;
+
+string tmp_dir = "/tmp";
+streambuf * cout_buf = NULL;
+ofstream null_stream;
+
+int failed = 0;
+
+void check(bool ok, string what){
+
+	cerr << (ok ? "OK     " : "FAILED ") << what << endl;
+	if(not ok) failed++;
+
+}
+
+//TERM -> 0, A,C,G,N,T -> 1..5, so that strings compare as the suffixes of the eBWT
+string ranks(string s){
+
+	for(auto & c : s) c = c == 'A' ? 1 : c == 'C' ? 2 : c == 'G' ? 3 : c == 'N' ? 4 : c == 'T' ? 5 : 0;
+	return s;
+
+}
+
+/*
+ * number of suffixes W'.TERM of the reads smaller than W (= begin of the BWT interval of W)
+ */
+uint64_t begin_of(vector<string> & reads, string W){
+
+	W = ranks(W);
+	uint64_t b = 0;
+
+	for(auto & r : reads){
+
+		string t = ranks(r) + char(0);
+		for(uint64_t i = 0; i < t.size(); ++i) b += t.substr(i) < W;
+
+	}
+
+	return b;
+
+}
+
+struct occurrences{
+
+	uint64_t count[2] = {0, 0};
+	set<pair<char, uint64_t> > left, right;//terminators are (0, unique id)
+
+};
+
+/*
+ * maximal repeats of length >= L of the union of the collections, occurring in all of them, by brute force.
+ * Records: |W|, count in each collection, begin in each collection.
+ */
+set<record> expected(vector<vector<string> > C, uint64_t L){
+
+	map<string, occurrences> occ;
+	uint64_t id = 0;
+
+	for(uint64_t k = 0; k < C.size(); ++k){
+
+		for(auto & r : C[k]){
+
+			for(uint64_t i = 0; i < r.size(); ++i){
+
+				for(uint64_t j = i+L; j <= r.size(); ++j){
+
+					auto & o = occ[r.substr(i, j-i)];
+
+					o.count[k]++;
+					o.left.insert(i == 0 ? make_pair(char(0), id) : make_pair(r[i-1], uint64_t(0)));
+					o.right.insert(j == r.size() ? make_pair(char(0), id) : make_pair(r[j], uint64_t(0)));
+
+				}
+
+			}
+
+			id++;
+
+		}
+
+	}
+
+	set<record> E;
+
+	for(auto & e : occ){
+
+		auto & o = e.second;
+
+		if(o.left.size() < 2 or o.right.size() < 2) continue;
+		if(C.size() == 2 and (o.count[0] == 0 or o.count[1] == 0)) continue;
+
+		record R = {e.first.size()};
+		for(uint64_t k = 0; k < C.size(); ++k) R.push_back(o.count[k]);
+		for(uint64_t k = 0; k < C.size(); ++k) R.push_back(begin_of(C[k], e.first));
+
+		E.insert(R);
+
+	}
+
+	return E;
+
+}
+
+/*
+ * records of a repeats file (same layout as those of expected(): |W|, counts, begins). Empty if the header is wrong.
+ */
+set<record> load_repeats(string path, uint64_t record_words){
+
+	ifstream in(path, ios::binary);
+
+	uint64_t header[REP_HEADER_WORDS];
+	in.read((char*)header, sizeof(header));
+
+	set<record> R;
+
+	if(memcmp(header, REP_MAGIC, 4) != 0 or header[3] != record_words) return R;
+
+	for(uint64_t i = 0; i < header[2]; ++i){
+
+		record r(record_words);
+		in.read((char*)r.data(), record_words*sizeof(uint64_t));
+
+		R.insert(r);
+
+	}
+
+	return R;
+
+}
+
+template<class bwt_t>
+set<record> bwt2lcp_repeats(vector<string> reads, uint64_t L){
+
+	string bwt = ebwt(reads);
+	save_string(tmp_dir + "/test_repeats.bwt", bwt);
+
+	bwt_t BWT(tmp_dir + "/test_repeats.bwt");
+
+	lcp_options opt;
+
+	opt.repeats_path = tmp_dir + "/test_repeats.rep";
+	opt.min_repeat = L;
+
+	cout.rdbuf(null_stream.rdbuf());
+	lcp<bwt_t, uint8_t> M(&BWT, opt);
+	cout.rdbuf(cout_buf);
+
+	return load_repeats(tmp_dir + "/test_repeats.rep", REP_LCP_RECORD_WORDS);
+
+}
+
+template<class bwt_t>
+set<record> merge_bwt_repeats(vector<string> reads1, vector<string> reads2, uint64_t L, bool compute_lcp){
+
+	string bwt1 = ebwt(reads1);
+	string bwt2 = ebwt(reads2);
+	save_string(tmp_dir + "/test_repeats1.bwt", bwt1);
+	save_string(tmp_dir + "/test_repeats2.bwt", bwt2);
+
+	bwt_t BWT1(tmp_dir + "/test_repeats1.bwt");
+	bwt_t BWT2(tmp_dir + "/test_repeats2.bwt");
+
+	merge_options opt;
+
+	opt.compute_lcp = compute_lcp;
+	opt.repeats_path = tmp_dir + "/test_repeats.rep";
+	opt.min_repeat = L;
+
+	cout.rdbuf(null_stream.rdbuf());
+	bwt_merger<bwt_t, uint8_t> M(&BWT1, &BWT2, opt);
+	cout.rdbuf(cout_buf);
+
+	return load_repeats(tmp_dir + "/test_repeats.rep", REP_MERGE_RECORD_WORDS);
+
+}
+
+template<class bwt_t>
+void test_bwt2lcp(vector<string> reads, uint64_t L, string what){
+
+	check(bwt2lcp_repeats<bwt_t>(reads, L) == expected({reads}, L), "bwt2lcp -R " + to_string(L) + ": " + what);
+
+}
+
+template<class bwt_t>
+void test_merge_bwt(vector<string> reads1, vector<string> reads2, uint64_t L, string what){
+
+	auto E = expected({reads1, reads2}, L);
+
+	check(merge_bwt_repeats<bwt_t>(reads1, reads2, L, false) == E, "merge_bwt -R " + to_string(L) + ": " + what);
+	check(merge_bwt_repeats<bwt_t>(reads1, reads2, L, true) == E, "merge_bwt -R " + to_string(L) + " (with LCP): " + what);
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc > 1) tmp_dir = string(argv[1]);
+
+	cout_buf = cout.rdbuf();
+
+	//a read shared by the collections is a maximal repeat (bounded by terminators on both sides)
+	vector<string> x1 = {"ACGTTGCAAG", "GGGTACCA", "TTTTCAGG"};
+	vector<string> x2 = {"ACGTTGCAAG", "CCATTGCA", "TACGATCG"};
+
+	auto R = merge_bwt_repeats<dna_bwt_t>(x1, x2, 5, false);
+	check(R.count({10, 1, 1, begin_of(x1, "ACGTTGCAAG"), begin_of(x2, "ACGTTGCAAG")}) == 1, "merge_bwt -R 5: shared read ACGTTGCAAG");
+
+	test_merge_bwt<dna_bwt_t>(x1, x2, 5, "shared read");
+	test_merge_bwt<dna_bwt_n_t>(x1, x2, 1, "shared read");
+
+	//duplicated reads, and repeats bounded by the beginning or end of reads (AAAC, TGAA)
+	vector<string> dup = {"CTAAAGACAA", "TACATAACATA", "ACGTCAGC", "CGAAAC", "TGTTGGCCCAGT", "TGAATCGCTT", "AGGGT",
+			"TAAGTAAGTGTGAT", "CATACGCCTT", "ACTTGCTGTGTC", "ACCCCAT", "CGGACTGGCATTTT", "CTAAAGACAA", "CGAAAC", "AAAC",
+			"TGAA", "ACGTACGT", "CGTACGTA", "GTAC"};
+
+	R = bwt2lcp_repeats<dna_bwt_t>(dup, 2);
+	check(R.size() == 60, "bwt2lcp -R 2: 60 maximal repeats");
+
+	for(auto W : vector<pair<string, uint64_t> >{{"CTAAAGACAA", 2}, {"CGAAAC", 2}, {"AAAC", 3}, {"TGAA", 2}})
+		check(R.count({W.first.size(), W.second, begin_of(dup, W.first)}) == 1, "bwt2lcp -R 2: " + W.first);
+
+	test_bwt2lcp<dna_bwt_t>(dup, 1, "duplicated reads");
+	test_bwt2lcp<dna_bwt_n_t>(dup, 2, "duplicated reads");
+
+	//random reads sampled from a short genome, with errors and 'N's
+	read_collection_params p;
+	p.genome_length = 60;
+	p.read_length = 12;
+	p.coverage = 4;
+	p.error_rate = 0.05;
+
+	for(uint64_t seed = 1; seed <= 4; ++seed){
+
+		p.seed = 2*seed;
+		p.n_rate = 0;
+		auto r1 = generate_reads(p, seed);
+
+		p.seed = 2*seed + 1;
+		auto r2 = generate_reads(p, seed);
+
+		test_bwt2lcp<dna_bwt_t>(r1, 1, "random reads, seed " + to_string(seed));
+		test_merge_bwt<dna_bwt_t>(r1, r2, 2, "random reads, seed " + to_string(seed));
+
+		p.n_rate = 0.05;
+		auto n1 = generate_reads(p, seed);
+
+		p.seed = 2*seed;
+		auto n2 = generate_reads(p, seed);
+
+		test_bwt2lcp<dna_bwt_n_t>(n1, 1, "random reads with N, seed " + to_string(seed));
+		test_merge_bwt<dna_bwt_n_t>(n1, n2, 2, "random reads with N, seed " + to_string(seed));
+
+	}
+
+	for(string f : {"/test_repeats.bwt", "/test_repeats1.bwt", "/test_repeats2.bwt", "/test_repeats.rep"})
+		remove((tmp_dir + f).c_str());
+
+	return failed == 0 ? 0 : 1;
+
+}